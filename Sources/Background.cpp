@@ -0,0 +1,98 @@
+#include "Background.hpp"
+#include "Debug.hpp"
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace avo {
+
+// scales image to cover whole size, and crops it at center
+static void drawImage(const std::string& path, cv::Mat& dst) {
+    cv::Mat image = cv::imread(path, cv::IMREAD_COLOR);
+    if (image.empty()) {
+        throw std::runtime_error("Unable to read background image: " + path);
+    }
+    double scale = std::max((double) dst.cols / image.cols, (double) dst.rows / image.rows);
+    cv::Size scaledSize(
+        std::max(dst.cols, (int) std::ceil(image.cols * scale)),
+        std::max(dst.rows, (int) std::ceil(image.rows * scale))
+    );
+    cv::Mat scaled;
+    cv::resize(image, scaled, scaledSize, 0, 0, scale < 1.0 ? cv::INTER_AREA : cv::INTER_CUBIC);
+    cv::Rect crop((scaledSize.width - dst.cols) / 2, (scaledSize.height - dst.rows) / 2, dst.cols, dst.rows);
+    scaled(crop).convertTo(dst, CV_32F);
+}
+
+// interpolates from current (flat) color of dst to given end color
+static void drawGradient(const Background& background, cv::Mat& dst) {
+    cv::Vec3f from = dst.at<cv::Vec3f>(0, 0);
+    cv::Vec3f to(background.gradientColor.blue, background.gradientColor.green, background.gradientColor.red);
+    float cx = (float) (dst.cols - 1) / 2.0f, cy = (float) (dst.rows - 1) / 2.0f;
+    // linear: projection on direction, normalized by half of projected output size
+    double radians = background.gradientAngle * CV_PI / 180.0;
+    float dx = (float) std::cos(radians), dy = (float) std::sin(radians);
+    float extent = background.gradient == GradientType::Radial
+        ? (float) std::hypot(dst.cols, dst.rows) / 2.0f
+        : (std::abs(dst.cols * dx) + std::abs(dst.rows * dy)) / 2.0f;
+
+    cv::parallel_for_(cv::Range(0, dst.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            auto* row = dst.ptr<cv::Vec3f>(y);
+            for (int x = 0; x < dst.cols; x++) {
+                float t = background.gradient == GradientType::Radial
+                    ? std::hypot(x - cx, y - cy) / extent
+                    : ((x - cx) * dx + (y - cy) * dy) / extent * 0.5f + 0.5f;
+                t = std::min(1.0f, std::max(0.0f, t));
+                row[x] = from * (1.0f - t) + to * t;
+            }
+        }
+    });
+}
+
+cv::Mat renderBackground(const OutputConfig& outputConfig) {
+    cv::Scalar color(outputConfig.backgroundColor.blue, outputConfig.backgroundColor.green, outputConfig.backgroundColor.red);
+    cv::Mat background(outputConfig.height, outputConfig.width, CV_32FC3, color);
+    const Background& layers = outputConfig.background;
+    if (!layers.imagePath.empty()) {
+        drawImage(layers.imagePath, background);
+    } else if (layers.gradient != GradientType::None) {
+        drawGradient(layers, background);
+    }
+
+    return background;
+}
+
+void applyDropShadow(cv::Mat& background, const Background& config, const cv::Mat& silhouette, cv::Rect rect) {
+    if (!config.hasShadow() || silhouette.empty()) {
+        return;
+    }
+    CV_Assert(background.type() == CV_32FC3 && silhouette.type() == CV_32FC1 && silhouette.size() == rect.size());
+
+    double sigma = config.shadowBlur * rect.height;
+    cv::Point offset((int) std::lround(config.shadowOffsetX * rect.height), (int) std::lround(config.shadowOffsetY * rect.height));
+    // blur spreads shadow beyond device frame by 3 sigma
+    int margin = (int) std::ceil(3.0 * sigma);
+    cv::Mat shadow;
+    cv::copyMakeBorder(silhouette, shadow, margin, margin, margin, margin, cv::BORDER_CONSTANT, cv::Scalar(0));
+    if (sigma > 0.0) {
+        cv::GaussianBlur(shadow, shadow, cv::Size(), sigma);
+    }
+
+    cv::Rect shadowRect(rect.tl() + offset - cv::Point(margin, margin), shadow.size());
+    cv::Rect visible = shadowRect & cv::Rect(0, 0, background.cols, background.rows);
+    if (visible.empty()) {
+        return;
+    }
+    DEBUG_PRINTLN("*** Drop shadow: sigma " << sigma << ", offset [" << offset.x << ", " << offset.y << "]");
+
+    // background * (1 - opacity * shadow)
+    cv::Mat factor, factor3;
+    shadow(visible - shadowRect.tl()).convertTo(factor, CV_32F, -config.shadowOpacity, 1.0);
+    cv::cvtColor(factor, factor3, cv::COLOR_GRAY2BGR);
+    cv::Mat region = background(visible);
+    cv::multiply(region, factor3, region);
+}
+
+} // namespace avo
@@ -0,0 +1,26 @@
+#ifndef SCREENFRAMER_BACKGROUND_HPP
+#define SCREENFRAMER_BACKGROUND_HPP
+
+#include <opencv2/core.hpp>
+#include "OutputConfig.hpp"
+
+namespace avo {
+
+/**
+ * Renders background of output: flat color, gradient or image (without shadow)
+ * @throws std::runtime_error if background image can't be read
+ * @return CV_32FC3 bgr image of output size, values in [0, 255]
+ */
+cv::Mat renderBackground(const OutputConfig& outputConfig);
+
+/**
+ * Darkens background with blurred and offset device silhouette
+ * @param background CV_32FC3 background of output
+ * @param silhouette CV_32FC1 device coverage [0.0, 1.0] (alpha, with screen area filled)
+ * @param rect position of device frame in background, shadow may extend beyond it
+ */
+void applyDropShadow(cv::Mat& background, const Background& config, const cv::Mat& silhouette, cv::Rect rect);
+
+} // namespace avo
+
+#endif //SCREENFRAMER_BACKGROUND_HPP
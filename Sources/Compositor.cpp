@@ -0,0 +1,107 @@
+#include "Compositor.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace avo {
+
+// returns true if pixel with given mask value has to be visited
+template<PixelFormat Format, BlendPolicy Policy>
+static inline bool isVisited(typename PixelFormatTraits<Format>::Sample mask) {
+    if constexpr (Policy == BlendPolicy::OpaqueCopy) {
+        return mask != 0;
+    } else if constexpr (Policy == BlendPolicy::EdgeOnly) {
+        return mask != PixelFormatTraits<Format>::maskMax;
+    } else {
+        return true;
+    }
+}
+
+template<PixelFormat Format, BlendPolicy Policy>
+Compositor<Format, Policy>::Compositor(const cv::Mat& mask): _mask(mask) {
+    using Sample = typename PixelFormatTraits<Format>::Sample;
+    CV_Assert(mask.type() == PixelFormatTraits<Format>::maskType);
+    _rowStarts.reserve(mask.rows + 1);
+    _rowStarts.push_back(0);
+    for (int y = 0; y < mask.rows; y++) {
+        const Sample* row = mask.ptr<Sample>(y);
+        int x = 0;
+        while (x < mask.cols) {
+            while (x < mask.cols && !isVisited<Format, Policy>(row[x])) {
+                x++;
+            }
+            int begin = x;
+            while (x < mask.cols && isVisited<Format, Policy>(row[x])) {
+                x++;
+            }
+            if (x > begin) {
+                _spans.emplace_back(begin, x);
+            }
+        }
+        _rowStarts.push_back((int) _spans.size());
+    }
+}
+
+template<PixelFormat Format, BlendPolicy Policy>
+void Compositor<Format, Policy>::apply(cv::Mat dst, const cv::Mat& source) const {
+    using Sample = typename PixelFormatTraits<Format>::Sample;
+    constexpr int cn = PixelFormatTraits<Format>::channels;
+    // exact rounded division by MAX = 2^bits - 1: (v + (v >> bits)) >> bits, where v = x + 2^(bits - 1)
+    constexpr uint32_t bits = sizeof(Sample) * 8;
+    constexpr uint32_t maxValue = (uint32_t) PixelFormatTraits<Format>::maskMax;
+    CV_Assert(dst.type() == PixelFormatTraits<Format>::type && source.type() == dst.type());
+    CV_Assert(dst.size() == _mask.size() && source.size() == _mask.size());
+    cv::parallel_for_(cv::Range(0, dst.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            Sample* out = dst.ptr<Sample>(y);
+            const Sample* src = source.ptr<Sample>(y);
+            const Sample* alpha = _mask.ptr<Sample>(y);
+            for (int s = _rowStarts[y]; s < _rowStarts[y + 1]; s++) {
+                int begin = _spans[s][0], end = _spans[s][1];
+                if constexpr (Policy == BlendPolicy::OpaqueCopy) {
+                    std::memcpy(out + cn * begin, src + cn * begin, sizeof(Sample) * cn * (end - begin));
+                } else {
+                    for (int x = begin; x < end; x++) {
+                        for (int c = 0; c < cn; c++) {
+                            if constexpr (std::is_floating_point_v<Sample>) {
+                                out[cn * x + c] = alpha[x] * out[cn * x + c] + src[cn * x + c];
+                            } else {
+                                // sum of two rounded terms may exceed MAX by one
+                                uint32_t v = (uint32_t) alpha[x] * out[cn * x + c] + (maxValue + 1) / 2;
+                                uint32_t sum = src[cn * x + c] + ((v + (v >> bits)) >> bits);
+                                out[cn * x + c] = (Sample) std::min<uint32_t>(sum, maxValue);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+template<PixelFormat Format, BlendPolicy Policy>
+bool Compositor<Format, Policy>::empty() const {
+    return _mask.empty();
+}
+
+template<PixelFormat Format, BlendPolicy Policy>
+size_t Compositor<Format, Policy>::visitedPixels() const {
+    size_t count = 0;
+    for (const auto& span : _spans) {
+        count += span[1] - span[0];
+    }
+    return count;
+}
+
+// explicit instantiation
+template class Compositor<PixelFormat::BGR24, BlendPolicy::OpaqueCopy>;
+template class Compositor<PixelFormat::BGR24, BlendPolicy::PremultipliedOver>;
+template class Compositor<PixelFormat::BGR24, BlendPolicy::EdgeOnly>;
+template class Compositor<PixelFormat::BGR48, BlendPolicy::OpaqueCopy>;
+template class Compositor<PixelFormat::BGR48, BlendPolicy::PremultipliedOver>;
+template class Compositor<PixelFormat::BGR48, BlendPolicy::EdgeOnly>;
+template class Compositor<PixelFormat::BGR96F, BlendPolicy::PremultipliedOver>;
+template class Compositor<PixelFormat::BGR96F, BlendPolicy::EdgeOnly>;
+
+} // namespace avo
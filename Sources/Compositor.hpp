@@ -0,0 +1,91 @@
+#ifndef SCREENFRAMER_COMPOSITOR_HPP
+#define SCREENFRAMER_COMPOSITOR_HPP
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace avo {
+
+// Packed pixel layouts of composited layers
+enum class PixelFormat {
+    BGR24,
+    // 16 bits per channel, for sources above 8 bits (e.g. 10-bit video)
+    BGR48,
+    // float channels in [0, 255] range, layout of default (non-compact) task buffers
+    BGR96F
+};
+
+template<PixelFormat Format>
+struct PixelFormatTraits;
+
+template<>
+struct PixelFormatTraits<PixelFormat::BGR24> {
+    using Sample = uint8_t;
+    static constexpr int channels = 3;
+    static constexpr int type = CV_8UC3;
+    static constexpr int maskType = CV_8UC1;
+    // mask value of full coverage / fully transparent source
+    static constexpr Sample maskMax = 255;
+};
+
+template<>
+struct PixelFormatTraits<PixelFormat::BGR48> {
+    using Sample = uint16_t;
+    static constexpr int channels = 3;
+    static constexpr int type = CV_16UC3;
+    static constexpr int maskType = CV_16UC1;
+    static constexpr Sample maskMax = 65535;
+};
+
+template<>
+struct PixelFormatTraits<PixelFormat::BGR96F> {
+    using Sample = float;
+    static constexpr int channels = 3;
+    static constexpr int type = CV_32FC3;
+    static constexpr int maskType = CV_32FC1;
+    static constexpr Sample maskMax = 1.0f;
+};
+
+enum class BlendPolicy {
+    // source replaces destination where mask (coverage) is nonzero
+    OpaqueCopy,
+    // premultiplied source over destination: dst = src + inverseAlpha * dst / MAX (255, 65535 or 1.0)
+    PremultipliedOver,
+    // as PremultipliedOver, but pixels where source is fully transparent (inverseAlpha MAX) are skipped
+    EdgeOnly
+};
+
+/**
+ * Composites source layer over destination of the same size, in arithmetic of format's sample type
+ * (integer with exact rounding, or float with the same operations as cv::multiply and cv::add).
+ * Pixel format and blend policy are compile-time parameters, so per-pixel loops
+ * have no runtime dispatch. Mask is static (e.g. template alpha), spans of pixels
+ * which have to be visited are found once, on construction.
+ */
+template<PixelFormat Format, BlendPolicy Policy>
+class Compositor {
+private:
+    // coverage (OpaqueCopy) or inverted source alpha (blending policies), sample size of Format
+    cv::Mat _mask;
+    // spans [x0, x1) of row y are _spans[_rowStarts[y]] ... _spans[_rowStarts[y + 1] - 1]
+    std::vector<int> _rowStarts;
+    std::vector<cv::Vec2i> _spans;
+public:
+    Compositor() = default;
+    explicit Compositor(const cv::Mat& mask);
+
+    /**
+     * Composites source over dst, rows are processed in parallel
+     * @param dst destination of Format type, same size as mask
+     * @param source source of Format type (premultiplied for blending policies)
+     */
+    void apply(cv::Mat dst, const cv::Mat& source) const;
+    bool empty() const;
+    // number of pixels visited by apply
+    size_t visitedPixels() const;
+};
+
+} // namespace avo
+
+#endif //SCREENFRAMER_COMPOSITOR_HPP
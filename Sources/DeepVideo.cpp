@@ -0,0 +1,254 @@
+#include "DeepVideo.hpp"
+#include "LibavSupport.hpp"
+#include "Placement.hpp"
+#include "Debug.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#ifdef SF_WITH_LIBAV
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+#endif
+
+namespace avo {
+
+// SDR to HDR signal mapping
+
+// reference white of BT.2408 relative to PQ peak (10000 cd/m2)
+static constexpr double PQ_REFERENCE_WHITE = 203.0 / 10000.0;
+// scene light of HLG, which is encoded as 75% signal (BT.2408 reference white)
+static const double HLG_REFERENCE_WHITE = (std::exp((0.75 - 0.55991073) / 0.17883277) + 0.28466892) / 12.0;
+
+static double srgbToLinear(double v) {
+    return v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+}
+
+// inverse EOTF of SMPTE ST 2084, light relative to 10000 cd/m2
+static double pqEncode(double light) {
+    constexpr double m1 = 2610.0 / 16384.0, m2 = 2523.0 / 4096.0 * 128.0;
+    constexpr double c1 = 3424.0 / 4096.0, c2 = 2413.0 / 4096.0 * 32.0, c3 = 2392.0 / 4096.0 * 32.0;
+    double p = std::pow(std::max(light, 0.0), m1);
+    return std::pow((c1 + c2 * p) / (1.0 + c3 * p), m2);
+}
+
+// OETF of ARIB STD-B67, scene light in [0, 1]
+static double hlgEncode(double light) {
+    light = std::max(light, 0.0);
+    return light <= 1.0 / 12.0 ? std::sqrt(3.0 * light) : 0.17883277 * std::log(12.0 * light - 0.28466892) + 0.55991073;
+}
+
+void sdrToSignal(const cv::Mat& src, cv::Mat& dst, const ColorInfo& colorInfo) {
+    if (src.channels() != 3 || (src.depth() != CV_8U && src.depth() != CV_32F)) {
+        throw std::invalid_argument("Colors must be CV_8UC3 or CV_32FC3 image");
+    }
+    if (!colorInfo.isHdr()) {
+        src.convertTo(dst, CV_16U, 257.0);
+        return;
+    }
+
+    // linear BT.709 -> linear BT.2020 (BT.2087), rows in bgr order
+    static const double toBT2020[3][3] = {
+        {0.8956, 0.0880, 0.0164},
+        {0.0114, 0.9195, 0.0691},
+        {0.0433, 0.3293, 0.6274}
+    };
+    bool bt2020 = colorInfo.primaries == ColorInfo::BT2020_PRIMARIES;
+    bool pq = colorInfo.transfer == ColorInfo::PQ_TRANSFER;
+    double white = pq ? PQ_REFERENCE_WHITE : HLG_REFERENCE_WHITE;
+
+    cv::Mat source;
+    src.convertTo(source, CV_32F, 1.0 / 255.0);
+    dst.create(src.size(), CV_16UC3);
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            const cv::Vec3f* in = source.ptr<cv::Vec3f>(y);
+            cv::Vec3w* out = dst.ptr<cv::Vec3w>(y);
+            for (int x = 0; x < src.cols; x++) {
+                double linear[3];
+                for (int c = 0; c < 3; c++) {
+                    linear[c] = srgbToLinear(std::min(std::max((double) in[x][c], 0.0), 1.0));
+                }
+                for (int c = 0; c < 3; c++) {
+                    double light = bt2020
+                        ? toBT2020[c][0] * linear[0] + toBT2020[c][1] * linear[1] + toBT2020[c][2] * linear[2]
+                        : linear[c];
+                    light *= white;
+                    out[x][c] = cv::saturate_cast<uint16_t>((pq ? pqEncode(light) : hlgEncode(light)) * 65535.0);
+                }
+            }
+        }
+    });
+}
+
+#ifdef SF_WITH_LIBAV
+
+static ColorInfo colorInfoOf(const AVCodecParameters* params) {
+    ColorInfo info;
+    info.primaries = params->color_primaries;
+    info.transfer = params->color_trc;
+    info.matrix = params->color_space;
+    info.fullRange = params->color_range == AVCOL_RANGE_JPEG;
+    return info;
+}
+
+VideoColorFormat probeVideoColorFormat(const std::string& path) {
+    int videoIndex;
+    InputContext input = openMediaInput(path, AVMEDIA_TYPE_VIDEO, videoIndex);
+    checkAV(videoIndex, "No video stream in " + path);
+
+    const AVCodecParameters* params = input->streams[videoIndex]->codecpar;
+    VideoColorFormat format;
+    format.colorInfo = colorInfoOf(params);
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get((AVPixelFormat) params->format);
+    if (descriptor != nullptr) {
+        format.bitDepth = descriptor->comp[0].depth;
+    } else if (params->bits_per_raw_sample > 0) {
+        format.bitDepth = params->bits_per_raw_sample;
+    }
+    return format;
+}
+
+struct DeepVideoReader::State {
+    InputContext input;
+    int videoIndex = -1;
+    CodecContext decoder;
+    Frame frame;
+    Packet packet;
+    Scaler scaler;
+    bool flushed = false;
+
+    // converts decoded frame into 16-bit bgr with colorimetry of stream
+    void convert(cv::Mat& bgr) {
+        AVFrame* f = frame.get();
+        scaler.reset(sws_getCachedContext(
+            scaler.release(), f->width, f->height, (AVPixelFormat) f->format,
+            f->width, f->height, AV_PIX_FMT_BGR48LE,
+            SWS_BILINEAR | SWS_ACCURATE_RND, nullptr, nullptr, nullptr
+        ));
+        if (scaler == nullptr) {
+            throw std::runtime_error("Unable to convert frames of pixel format " + std::to_string(f->format));
+        }
+        int matrix = f->colorspace != AVCOL_SPC_UNSPECIFIED ? f->colorspace : decoder->colorspace;
+        bool fullRange = f->color_range == AVCOL_RANGE_JPEG || decoder->color_range == AVCOL_RANGE_JPEG;
+        sws_setColorspaceDetails(
+            scaler.get(), sws_getCoefficients(matrix), fullRange ? 1 : 0,
+            sws_getCoefficients(SWS_CS_DEFAULT), 1, 0, 1 << 16, 1 << 16
+        );
+
+        // BGR48LE matches CV_16UC3 layout on little endian hosts
+        bgr.create(f->height, f->width, CV_16UC3);
+        uint8_t* dst[] = {bgr.data};
+        const int dstStride[] = {(int) bgr.step};
+        sws_scale(scaler.get(), f->data, f->linesize, 0, f->height, dst, dstStride);
+    }
+};
+
+#else
+
+VideoColorFormat probeVideoColorFormat(const std::string&) {
+    throw std::runtime_error("screenframer was built without libav support");
+}
+
+struct DeepVideoReader::State {};
+
+#endif
+
+DeepVideoReader::DeepVideoReader() = default;
+
+DeepVideoReader::~DeepVideoReader() = default;
+
+void DeepVideoReader::open(const std::string& path) {
+#ifdef SF_WITH_LIBAV
+    auto state = std::make_unique<State>();
+    state->input = openMediaInput(path, AVMEDIA_TYPE_VIDEO, state->videoIndex);
+    checkAV(state->videoIndex, "No video stream in " + path);
+
+    const AVCodecParameters* params = state->input->streams[state->videoIndex]->codecpar;
+    const AVCodec* codec = avcodec_find_decoder(params->codec_id);
+    if (codec == nullptr) {
+        throw std::runtime_error("No decoder for video stream of " + path);
+    }
+    state->decoder.reset(avcodec_alloc_context3(codec));
+    checkAV(avcodec_parameters_to_context(state->decoder.get(), params), "Unable to set decoder parameters");
+    // frame threads of decoder are created while it's opened
+    state->decoder->thread_count = 0;
+    {
+        ScopedPlacement placement(Stage::Decode);
+        checkAV(avcodec_open2(state->decoder.get(), codec, nullptr), "Unable to open decoder of " + path);
+    }
+    state->frame.reset(av_frame_alloc());
+    state->packet.reset(av_packet_alloc());
+    DEBUG_PRINTLN("*** Deep color decoder: " << codec->name << ", " << av_get_pix_fmt_name(state->decoder->pix_fmt));
+    _state = std::move(state);
+#else
+    (void) path;
+    throw std::runtime_error("screenframer was built without libav support");
+#endif
+}
+
+bool DeepVideoReader::read(cv::Mat& bgr) {
+#ifdef SF_WITH_LIBAV
+    if (_state == nullptr) {
+        return false;
+    }
+
+    State& s = *_state;
+    while (true) {
+        int result = avcodec_receive_frame(s.decoder.get(), s.frame.get());
+        if (result >= 0) {
+            s.convert(bgr);
+            av_frame_unref(s.frame.get());
+            return true;
+        }
+        if (result == AVERROR_EOF) {
+            return false;
+        }
+        if (result != AVERROR(EAGAIN)) {
+            checkAV(result, "Unable to decode frame");
+        }
+
+        // decoder needs more input, at the end it's flushed with empty packet
+        if (s.flushed) {
+            return false;
+        }
+        result = av_read_frame(s.input.get(), s.packet.get());
+        if (result == AVERROR_EOF) {
+            s.flushed = true;
+            checkAV(avcodec_send_packet(s.decoder.get(), nullptr), "Unable to flush decoder");
+            continue;
+        }
+        checkAV(result, "Unable to read packet");
+        if (s.packet->stream_index == s.videoIndex) {
+            result = avcodec_send_packet(s.decoder.get(), s.packet.get());
+        }
+        av_packet_unref(s.packet.get());
+        checkAV(result, "Unable to decode packet");
+    }
+#else
+    (void) bgr;
+    return false;
+#endif
+}
+
+double DeepVideoReader::fps() const {
+#ifdef SF_WITH_LIBAV
+    if (_state != nullptr) {
+        AVStream* stream = _state->input->streams[_state->videoIndex];
+        return av_q2d(av_guess_frame_rate(_state->input.get(), stream, nullptr));
+    }
+#endif
+    return 0.0;
+}
+
+int DeepVideoReader::frameCount() const {
+#ifdef SF_WITH_LIBAV
+    if (_state != nullptr) {
+        return (int) _state->input->streams[_state->videoIndex]->nb_frames;
+    }
+#endif
+    return 0;
+}
+
+} // namespace avo
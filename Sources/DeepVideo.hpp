@@ -0,0 +1,63 @@
+#ifndef SCREENFRAMER_DEEPVIDEO_HPP
+#define SCREENFRAMER_DEEPVIDEO_HPP
+
+#include <opencv2/core.hpp>
+#include <memory>
+#include <string>
+#include "OutputConfig.hpp"
+
+namespace avo {
+
+// Format of first video stream of a file
+struct VideoColorFormat {
+    // bits per sample of decoded frames, e.g. 8 for most H.264, 10 for HDR HEVC
+    int bitDepth = 8;
+    ColorInfo colorInfo;
+};
+
+/**
+ * Reads color format of video stream from container / codec parameters, no frames are decoded
+ * @throws std::runtime_error if file has no video stream or screenframer was built without libav
+ */
+VideoColorFormat probeVideoColorFormat(const std::string& path);
+
+/**
+ * Converts sRGB colors of template or background (CV_8UC3, or CV_32FC3 in 0 - 255 range) into 16-bit bgr
+ * (CV_16UC3) signal of video with given colorimetry. SDR colors are scaled by 257. For PQ and HLG, colors
+ * are converted to BT.2020 primaries (if video has them) and white is placed at reference white
+ * of BT.2408 (203 cd/m2, 75% of HLG signal), so that template is not brighter than graphics of HDR video.
+ */
+void sdrToSignal(const cv::Mat& src, cv::Mat& dst, const ColorInfo& colorInfo);
+
+/**
+ * Decodes first video stream of a file with libavcodec into 16-bit bgr frames (CV_16UC3),
+ * so that samples of 10-bit (e.g. P010, yuv420p10) video are not truncated.
+ * YUV is converted with matrix and range of the stream, transfer function is left untouched.
+ * Frame rotation metadata is not applied.
+ */
+class DeepVideoReader {
+private:
+    struct State;
+    std::unique_ptr<State> _state;
+public:
+    DeepVideoReader();
+    ~DeepVideoReader();
+
+    /**
+     * Opens file and its video decoder (decoder threads are placed on decode CPUs)
+     * @throws std::runtime_error if file can't be decoded or screenframer was built without libav
+     */
+    void open(const std::string& path);
+    /**
+     * Decodes next frame into bgr, buffer is reused if it has right size and type
+     * @return false at the end of stream
+     */
+    bool read(cv::Mat& bgr);
+    double fps() const;
+    // number of frames declared by container, 0 if unknown
+    int frameCount() const;
+};
+
+} // namespace avo
+
+#endif //SCREENFRAMER_DEEPVIDEO_HPP
@@ -0,0 +1,188 @@
+#include "FramePool.hpp"
+#include "Placement.hpp"
+#include "Debug.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace avo {
+
+FramePool::~FramePool() {
+    trim();
+}
+
+size_t FramePool::blockSize(size_t bytes) {
+    return std::max<size_t>(PAGE_SIZE, (bytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE);
+}
+
+size_t FramePool::freeListKey(size_t size, int node) {
+    return size | ((size_t) node & (PAGE_SIZE - 1));
+}
+
+void* FramePool::acquireBlock(size_t size) const {
+    // blocks are first touched by allocating thread, so their pages are local to its node
+    bool numaAware = _numaAware.load(std::memory_order_relaxed);
+    int node = numaAware ? currentNumaNode() : 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _freeBlocks.find(freeListKey(size, node));
+        if (it != _freeBlocks.end() && !it->second.empty()) {
+            void* block = it->second.back();
+            it->second.pop_back();
+            _leasedBytes += size;
+            _peakLeasedBytes = std::max(_peakLeasedBytes, _leasedBytes);
+            return block;
+        }
+    }
+
+    // page alignment covers both cache line and SIMD register alignment
+    bool huge = _hugePages.load(std::memory_order_relaxed) && size >= HUGE_PAGE_SIZE;
+    size_t alignment = huge ? HUGE_PAGE_SIZE : PAGE_SIZE;
+    void* block = nullptr;
+    if (posix_memalign(&block, alignment, size) != 0) {
+        throw std::bad_alloc();
+    }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (huge) {
+        madvise(block, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (numaAware) {
+        _blockNodes[block] = node;
+    }
+    _reservedBytes += size;
+    _leasedBytes += size;
+    _peakLeasedBytes = std::max(_peakLeasedBytes, _leasedBytes);
+    return block;
+}
+
+cv::UMatData* FramePool::allocate(
+    int dims, const int* sizes, int type, void* data,
+    size_t* step, cv::AccessFlag, cv::UMatUsageFlags
+) const {
+    // continuous layout, same as default allocator
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data && step[i] != CV_AUTOSTEP) {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    auto* u = new cv::UMatData(this);
+    u->size = total;
+    if (data) {
+        u->data = u->origdata = (uchar*) data;
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+    } else {
+        u->data = u->origdata = (uchar*) acquireBlock(blockSize(total));
+    }
+
+    return u;
+}
+
+bool FramePool::allocate(cv::UMatData* data, cv::AccessFlag, cv::UMatUsageFlags) const {
+    return data != nullptr;
+}
+
+void FramePool::deallocate(cv::UMatData* u) const {
+    if (u == nullptr) {
+        return;
+    }
+
+    CV_Assert(u->urefcount == 0 && u->refcount == 0);
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED) && u->origdata != nullptr) {
+        size_t size = blockSize(u->size);
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto node = _blockNodes.find(u->origdata);
+        _leasedBytes -= size;
+        size_t cachedBytes = _reservedBytes - _leasedBytes;
+        if (cachedBytes > _maxCachedBytes.load(std::memory_order_relaxed)) {
+            // pool keeps at most maxCachedBytes for reuse, so that peak of one job is not retained
+            if (node != _blockNodes.end()) {
+                _blockNodes.erase(node);
+            }
+            _reservedBytes -= size;
+            free(u->origdata);
+        } else {
+            _freeBlocks[freeListKey(size, node != _blockNodes.end() ? node->second : 0)].push_back(u->origdata);
+        }
+        u->origdata = nullptr;
+    }
+    delete u;
+}
+
+void FramePool::create(cv::Mat& mat, int rows, int cols, int type) {
+    mat.allocator = this;
+    mat.create(rows, cols, type);
+}
+
+void FramePool::setHugePages(bool enabled) {
+    _hugePages.store(enabled, std::memory_order_relaxed);
+}
+
+bool FramePool::hugePages() const {
+    return _hugePages.load(std::memory_order_relaxed);
+}
+
+void FramePool::setNumaAware(bool enabled) {
+    _numaAware.store(enabled, std::memory_order_relaxed);
+}
+
+bool FramePool::numaAware() const {
+    return _numaAware.load(std::memory_order_relaxed);
+}
+
+void FramePool::setMaxCachedBytes(size_t bytes) {
+    _maxCachedBytes.store(bytes, std::memory_order_relaxed);
+}
+
+size_t FramePool::maxCachedBytes() const {
+    return _maxCachedBytes.load(std::memory_order_relaxed);
+}
+
+void FramePool::trim() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& entry : _freeBlocks) {
+        for (void* block : entry.second) {
+            free(block);
+            _blockNodes.erase(block);
+            _reservedBytes -= entry.first & ~(PAGE_SIZE - 1);
+        }
+        entry.second.clear();
+    }
+}
+
+size_t FramePool::reservedBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _reservedBytes;
+}
+
+size_t FramePool::leasedBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _leasedBytes;
+}
+
+size_t FramePool::peakLeasedBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _peakLeasedBytes;
+}
+
+FramePool& FramePool::shared() {
+    // intentionally leaked, mats with static storage may outlive any static pool
+    static auto* pool = new FramePool();
+    return *pool;
+}
+
+} // namespace avo
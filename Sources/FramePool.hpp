@@ -0,0 +1,94 @@
+#ifndef SCREENFRAMER_FRAMEPOOL_HPP
+#define SCREENFRAMER_FRAMEPOOL_HPP
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+
+namespace avo {
+
+/**
+ * OpenCV allocator recycling aligned memory blocks.
+ * Mats using this allocator (mat.allocator = &pool) return their memory
+ * to the pool instead of the system, when last reference is released.
+ * Blocks are page aligned and rounded up to page size, so that
+ * repeated allocations of equally sized frames hit the same free list.
+ * Free blocks above maxCachedBytes are returned to the system.
+ */
+class FramePool: public cv::MatAllocator {
+public:
+    static constexpr size_t PAGE_SIZE = 4096;
+    static constexpr size_t DEFAULT_MAX_CACHED_BYTES = 512 * 1024 * 1024;
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+private:
+    mutable std::mutex _mutex;
+    // free blocks by size (page multiple) combined with NUMA node in low bits
+    mutable std::unordered_map<size_t, std::vector<void*>> _freeBlocks;
+    // NUMA node of every block, when pool is NUMA-aware
+    mutable std::unordered_map<void*, int> _blockNodes;
+    // bytes allocated from system (leased + cached)
+    mutable size_t _reservedBytes = 0;
+    // bytes currently used by mats
+    mutable size_t _leasedBytes = 0;
+    mutable size_t _peakLeasedBytes = 0;
+    std::atomic<bool> _hugePages{false};
+    std::atomic<bool> _numaAware{false};
+    std::atomic<size_t> _maxCachedBytes{DEFAULT_MAX_CACHED_BYTES};
+public:
+    FramePool() = default;
+    ~FramePool() override;
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    cv::UMatData* allocate(
+        int dims, const int* sizes, int type, void* data,
+        size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags
+    ) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+    /**
+     * Allocates mat memory from this pool
+     * @param mat mat to (re)allocate, does nothing if it has already given size and type
+     */
+    void create(cv::Mat& mat, int rows, int cols, int type);
+
+    // back large blocks with transparent huge pages (Linux only)
+    void setHugePages(bool enabled);
+    bool hugePages() const;
+    // reuse free blocks only on NUMA node of thread, which allocated them
+    void setNumaAware(bool enabled);
+    bool numaAware() const;
+
+    // limit of free blocks kept for reuse, blocks released above it are freed immediately
+    void setMaxCachedBytes(size_t bytes);
+    size_t maxCachedBytes() const;
+    // frees cached blocks, which are not leased at the moment (e.g. at the end of job)
+    void trim();
+    size_t reservedBytes() const;
+    size_t leasedBytes() const;
+    size_t peakLeasedBytes() const;
+
+    // process-wide pool, shared by decoder, tasks and writers
+    static FramePool& shared();
+private:
+    static size_t blockSize(size_t bytes);
+    static size_t freeListKey(size_t size, int node);
+    void* acquireBlock(size_t size) const;
+};
+
+// assigns shared pool allocator to host mats, device mats (cv::UMat) are left untouched
+template<class MatType>
+inline void usePool(MatType&) {}
+
+template<>
+inline void usePool<cv::Mat>(cv::Mat& mat) {
+    mat.allocator = &FramePool::shared();
+}
+
+} // namespace avo
+
+#endif //SCREENFRAMER_FRAMEPOOL_HPP
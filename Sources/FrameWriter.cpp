@@ -0,0 +1,868 @@
+#include "FrameWriter.hpp"
+#include "FramePool.hpp"
+#include "Remux.hpp"
+#include "LibavSupport.hpp"
+#include "RawVideo.hpp"
+#include "Placement.hpp"
+#include "Debug.hpp"
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <cctype>
+#include <cstring>
+#include <cerrno>
+#include <numeric>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef MACOS_APP
+#define API_PREFERENCE cv::CAP_AVFOUNDATION
+#else
+#define API_PREFERENCE cv::CAP_ANY
+#endif
+
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 11)
+#define SF_HAVE_CV_ANIMATION
+#endif
+
+namespace avo {
+
+// FrameWriter
+
+bool FrameWriter::usesStaticFrame() const {
+    return false;
+}
+
+void FrameWriter::setStaticFrame(const cv::Mat&, const cv::Mat&) {}
+
+static std::string lowercaseExtension(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext;
+}
+
+bool isAnimatedImagePath(const std::string& path) {
+    std::string ext = lowercaseExtension(path);
+    // .png is left for single images (screenshots, previews), animated PNG needs explicit .apng
+    return ext == ".gif" || ext == ".webp" || ext == ".apng";
+}
+
+std::unique_ptr<FrameWriter> FrameWriter::create(const std::string& path, const std::string& audioSourcePath, int crf) {
+    std::string ext = lowercaseExtension(path);
+    if (ext == ".gif") {
+        return std::make_unique<GifWriter>();
+    } else if (isAnimatedImagePath(path)) {
+        return std::make_unique<AnimationWriter>();
+    } else if (ext == ".y4m") {
+        return std::make_unique<RawVideoWriter>(RawPixelFormat::I420, true);
+    } else if (isHeaderlessRawVideoPath(path)) {
+        return std::make_unique<RawVideoWriter>(rawPixelFormatOf(path), false);
+    }
+
+    // cv::VideoWriter can't carry audio
+    if (!audioSourcePath.empty() && LibavFrameWriter::isAvailable() && hasAudioStream(audioSourcePath)) {
+        return std::make_unique<LibavFrameWriter>(audioSourcePath, crf);
+    }
+
+    return std::make_unique<VideoFrameWriter>();
+}
+
+// VideoFrameWriter
+
+bool VideoFrameWriter::open(const std::string& path, double fps, cv::Size size) {
+    int fourcc = cv::VideoWriter::fourcc('a', 'v', 'c', '1');
+    return _writer.open(path, API_PREFERENCE, fourcc, fps, size);
+}
+
+void VideoFrameWriter::write(cv::InputArray frame) {
+    _writer.write(frame);
+}
+
+bool VideoFrameWriter::isOpened() const {
+    return _writer.isOpened();
+}
+
+void VideoFrameWriter::release() {
+    _writer.release();
+}
+
+std::string VideoFrameWriter::backendName() const {
+    return _writer.getBackendName();
+}
+
+// LibavFrameWriter
+
+#ifdef SF_WITH_LIBAV
+
+struct LibavFrameWriter::State {
+    OutputContext output;
+    CodecContext encoder;
+    Frame frame;
+    Packet packet;
+    AVStream* stream = nullptr;
+    AudioPassthrough audio;
+    // encoded part of input frames (4:2:0 subsampling requires even dimensions)
+    cv::Rect area;
+    // planar I420 frame
+    cv::Mat yuv;
+    // deep color: BGR48 to 10-bit 4:2:0 conversion, and 16-bit copy of 8-bit input frames
+    Scaler scaler;
+    cv::Mat deepFrame;
+    int64_t frameIndex = 0;
+
+    // writes packets produced by encoder, each preceded by audio up to its timestamp
+    void drainEncoder() {
+        int result;
+        while ((result = avcodec_receive_packet(encoder.get(), packet.get())) >= 0) {
+            av_packet_rescale_ts(packet.get(), encoder->time_base, stream->time_base);
+            packet->stream_index = stream->index;
+            audio.writeUntil(output.get(), packet->dts, stream->time_base);
+            // takes ownership of packet data
+            checkAV(av_interleaved_write_frame(output.get(), packet.get()), "Unable to write video packet");
+        }
+        if (result != AVERROR(EAGAIN) && result != AVERROR_EOF) {
+            checkAV(result, "Unable to encode frame");
+        }
+    }
+};
+
+#else
+
+struct LibavFrameWriter::State {};
+
+#endif
+
+#ifdef SF_WITH_LIBAV
+// HEVC encoder accepting 10-bit 4:2:0 frames, libx265 preferred
+static const AVCodec* findDeepColorEncoder() {
+    for (const AVCodec* codec : {avcodec_find_encoder_by_name("libx265"), avcodec_find_encoder(AV_CODEC_ID_HEVC)}) {
+        if (codec == nullptr) {
+            continue;
+        }
+        const AVPixelFormat* formats = nullptr;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+        if (avcodec_get_supported_config(nullptr, codec, AV_CODEC_CONFIG_PIX_FORMAT, 0, (const void**) &formats, nullptr) < 0) {
+            continue;
+        }
+#else
+        formats = codec->pix_fmts;
+#endif
+        for (; formats != nullptr && *formats != AV_PIX_FMT_NONE; formats++) {
+            if (*formats == AV_PIX_FMT_YUV420P10LE) {
+                return codec;
+            }
+        }
+    }
+    return nullptr;
+}
+#endif
+
+LibavFrameWriter::LibavFrameWriter(std::string audioSourcePath, int crf, bool deepColor, ColorInfo colorInfo):
+    _audioSourcePath(std::move(audioSourcePath)), _crf(crf), _deepColor(deepColor), _colorInfo(colorInfo) {}
+
+LibavFrameWriter::~LibavFrameWriter() = default;
+
+bool LibavFrameWriter::isAvailable() {
+#ifdef SF_WITH_LIBAV
+    return avcodec_find_encoder(AV_CODEC_ID_H264) != nullptr;
+#else
+    return false;
+#endif
+}
+
+bool LibavFrameWriter::isDeepColorAvailable() {
+#ifdef SF_WITH_LIBAV
+    return findDeepColorEncoder() != nullptr;
+#else
+    return false;
+#endif
+}
+
+bool LibavFrameWriter::open(const std::string& path, double fps, cv::Size size) {
+#ifdef SF_WITH_LIBAV
+    const AVCodec* codec = _deepColor ? findDeepColorEncoder() : avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (codec == nullptr || size.width < 2 || size.height < 2) {
+        return false;
+    }
+
+    try {
+        auto state = std::make_unique<State>();
+        state->output = openMediaOutput(path);
+        state->area = cv::Rect(0, 0, size.width & ~1, size.height & ~1);
+
+        state->encoder.reset(avcodec_alloc_context3(codec));
+        AVCodecContext* encoder = state->encoder.get();
+        AVRational frameRate = av_d2q(fps, 100000);
+        encoder->width = state->area.width;
+        encoder->height = state->area.height;
+        encoder->pix_fmt = _deepColor ? AV_PIX_FMT_YUV420P10LE : AV_PIX_FMT_YUV420P;
+        encoder->framerate = frameRate;
+        encoder->time_base = av_inv_q(frameRate);
+        if (_deepColor) {
+            // samples are written in signal domain of source, so its colorimetry (e.g. PQ / BT.2020) is kept
+            encoder->color_primaries = (AVColorPrimaries) _colorInfo.primaries;
+            encoder->color_trc = (AVColorTransferCharacteristic) _colorInfo.transfer;
+            encoder->colorspace = (AVColorSpace) _colorInfo.matrix;
+            encoder->color_range = _colorInfo.fullRange ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+        } else {
+            // cv::COLOR_BGR2YUV_I420 gives limited range BT.601 samples of sRGB (BT.709 primaries) frames
+            encoder->color_primaries = AVCOL_PRI_BT709;
+            encoder->color_trc = AVCOL_TRC_BT709;
+            encoder->colorspace = AVCOL_SPC_SMPTE170M;
+            encoder->color_range = AVCOL_RANGE_MPEG;
+        }
+        if (state->output->oformat->flags & AVFMT_GLOBALHEADER) {
+            encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+        // quality based rate control of libx264 / libx265, other encoders ignore it
+        av_opt_set_int(encoder->priv_data, "crf", _crf, 0);
+        checkAV(avcodec_open2(encoder, codec, nullptr), _deepColor ? "Unable to open HEVC encoder" : "Unable to open H.264 encoder");
+
+        state->stream = avformat_new_stream(state->output.get(), nullptr);
+        if (state->stream == nullptr) {
+            throw std::runtime_error("Unable to create video stream");
+        }
+        checkAV(avcodec_parameters_from_context(state->stream->codecpar, encoder), "Unable to set video parameters");
+        state->stream->time_base = encoder->time_base;
+        const char* formatName = state->output->oformat->name;
+        if (_deepColor && (std::strstr(formatName, "mp4") != nullptr || std::strstr(formatName, "mov") != nullptr)) {
+            // Apple players accept HEVC in MP4 / QuickTime only with hvc1 tag (muxer default is hev1)
+            state->stream->codecpar->codec_tag = MKTAG('h', 'v', 'c', '1');
+        }
+        state->audio.open(_audioSourcePath, state->output.get());
+        checkAV(avformat_write_header(state->output.get(), nullptr), "Unable to write header of " + path);
+
+        state->frame.reset(av_frame_alloc());
+        state->frame->format = encoder->pix_fmt;
+        state->frame->width = encoder->width;
+        state->frame->height = encoder->height;
+        checkAV(av_frame_get_buffer(state->frame.get(), 0), "Unable to allocate frame");
+        state->packet.reset(av_packet_alloc());
+        if (_deepColor) {
+            state->scaler.reset(sws_getContext(
+                encoder->width, encoder->height, AV_PIX_FMT_BGR48LE,
+                encoder->width, encoder->height, AV_PIX_FMT_YUV420P10LE,
+                SWS_BILINEAR | SWS_ACCURATE_RND, nullptr, nullptr, nullptr
+            ));
+            if (state->scaler == nullptr) {
+                throw std::runtime_error("Unable to create 10-bit color converter");
+            }
+            // full range rgb to yuv with matrix and range of source
+            sws_setColorspaceDetails(
+                state->scaler.get(), sws_getCoefficients(SWS_CS_DEFAULT), 1,
+                sws_getCoefficients(_colorInfo.matrix), _colorInfo.fullRange ? 1 : 0, 0, 1 << 16, 1 << 16
+            );
+        }
+        _state = std::move(state);
+    } catch (const std::exception& e) {
+        DEBUG_PRINTLN("*** libav writer: " << e.what());
+        return false;
+    }
+
+    return true;
+#else
+    (void) path;
+    (void) fps;
+    (void) size;
+    return false;
+#endif
+}
+
+void LibavFrameWriter::write(cv::InputArray frame) {
+#ifdef SF_WITH_LIBAV
+    if (_state == nullptr) {
+        return;
+    }
+
+    State& s = *_state;
+    AVFrame* avFrame = s.frame.get();
+    checkAV(av_frame_make_writable(avFrame), "Unable to write frame");
+    if (_deepColor) {
+        cv::Mat bgr = frame.getMat()(s.area);
+        if (bgr.depth() != CV_16U) {
+            bgr.convertTo(s.deepFrame, CV_16U, 257.0);
+            bgr = s.deepFrame;
+        }
+        // swscale writes planes of frame directly
+        const uint8_t* src[] = {bgr.data};
+        const int srcStride[] = {(int) bgr.step};
+        sws_scale(s.scaler.get(), src, srcStride, 0, s.area.height, avFrame->data, avFrame->linesize);
+    } else {
+        cv::cvtColor(frame.getMat()(s.area), s.yuv, cv::COLOR_BGR2YUV_I420);
+        // yuv holds full Y plane followed by quarter U and V planes
+        const uint8_t* src = s.yuv.data;
+        for (int plane = 0; plane < 3; plane++) {
+            int width = plane == 0 ? s.area.width : s.area.width / 2;
+            int height = plane == 0 ? s.area.height : s.area.height / 2;
+            for (int y = 0; y < height; y++) {
+                std::memcpy(avFrame->data[plane] + (size_t) y * avFrame->linesize[plane], src, width);
+                src += width;
+            }
+        }
+    }
+    avFrame->pts = s.frameIndex++;
+    checkAV(avcodec_send_frame(s.encoder.get(), avFrame), "Unable to encode frame");
+    s.drainEncoder();
+#else
+    (void) frame;
+#endif
+}
+
+bool LibavFrameWriter::isOpened() const {
+    return _state != nullptr;
+}
+
+void LibavFrameWriter::release() {
+#ifdef SF_WITH_LIBAV
+    if (_state == nullptr) {
+        return;
+    }
+
+    // writer is closed even if flushing fails
+    std::unique_ptr<State> state = std::move(_state);
+    checkAV(avcodec_send_frame(state->encoder.get(), nullptr), "Unable to flush encoder");
+    state->drainEncoder();
+    state->audio.finish(state->output.get());
+    checkAV(av_write_trailer(state->output.get()), "Unable to finalize video");
+#endif
+}
+
+std::string LibavFrameWriter::backendName() const {
+#ifdef SF_WITH_LIBAV
+    if (_state != nullptr) {
+        return std::string("libav ") + _state->encoder->codec->name + (_deepColor ? " 10-bit" : "");
+    }
+#endif
+    return "libav";
+}
+
+// GifWriter
+
+namespace {
+
+void putShort(std::ostream& out, int value) {
+    out.put((char) (value & 0xff));
+    out.put((char) ((value >> 8) & 0xff));
+}
+
+// Packs variable length codes into 255-byte data sub-blocks
+class BlockWriter {
+private:
+    std::ostream& _out;
+    uint8_t _block[255];
+    int _blockSize = 0;
+    uint32_t _bitBuffer = 0;
+    int _bitCount = 0;
+public:
+    explicit BlockWriter(std::ostream& out): _out(out) {}
+
+    void writeCode(int code, int size) {
+        _bitBuffer |= (uint32_t) code << _bitCount;
+        _bitCount += size;
+        while (_bitCount >= 8) {
+            _block[_blockSize++] = (uint8_t) (_bitBuffer & 0xff);
+            _bitBuffer >>= 8;
+            _bitCount -= 8;
+            if (_blockSize == 255) {
+                flushBlock();
+            }
+        }
+    }
+
+    void finish() {
+        if (_bitCount > 0) {
+            _block[_blockSize++] = (uint8_t) (_bitBuffer & 0xff);
+            _bitBuffer = 0;
+            _bitCount = 0;
+        }
+        flushBlock();
+        _out.put(0);
+    }
+private:
+    void flushBlock() {
+        if (_blockSize == 0) {
+            return;
+        }
+        _out.put((char) _blockSize);
+        _out.write((const char*) _block, _blockSize);
+        _blockSize = 0;
+    }
+};
+
+// GIF variant of LZW with 8-bit minimum code size
+void lzwEncode(std::ostream& out, const cv::Mat& indices) {
+    constexpr int MIN_CODE_SIZE = 8;
+    constexpr int CLEAR_CODE = 1 << MIN_CODE_SIZE;
+    constexpr int EOI_CODE = CLEAR_CODE + 1;
+    constexpr int MAX_CODE = 4095;
+    constexpr int HASH_BITS = 13;
+    constexpr uint32_t HASH_SIZE = 1u << HASH_BITS;
+
+    out.put(MIN_CODE_SIZE);
+    BlockWriter writer(out);
+    // dictionary: (prefix code, next index) -> code
+    std::vector<int32_t> keys(HASH_SIZE, -1);
+    std::vector<uint16_t> codes(HASH_SIZE);
+    int codeSize = MIN_CODE_SIZE + 1;
+    int lastCode = EOI_CODE;
+    writer.writeCode(CLEAR_CODE, codeSize);
+
+    int prefix = -1;
+    for (int y = 0; y < indices.rows; y++) {
+        const uint8_t* row = indices.ptr<uint8_t>(y);
+        for (int x = 0; x < indices.cols; x++) {
+            int value = row[x];
+            if (prefix < 0) {
+                prefix = value;
+                continue;
+            }
+
+            int32_t key = (prefix << 8) | value;
+            uint32_t hash = ((uint32_t) key * 2654435761u) >> (32 - HASH_BITS);
+            while (keys[hash] != -1 && keys[hash] != key) {
+                hash = (hash + 1) & (HASH_SIZE - 1);
+            }
+            if (keys[hash] == key) {
+                prefix = codes[hash];
+                continue;
+            }
+
+            writer.writeCode(prefix, codeSize);
+            lastCode += 1;
+            keys[hash] = key;
+            codes[hash] = (uint16_t) lastCode;
+            if (lastCode >= (1 << codeSize) && codeSize < 12) {
+                codeSize += 1;
+            }
+            if (lastCode == MAX_CODE) {
+                // dictionary full, start over
+                writer.writeCode(CLEAR_CODE, codeSize);
+                std::fill(keys.begin(), keys.end(), -1);
+                codeSize = MIN_CODE_SIZE + 1;
+                lastCode = EOI_CODE;
+            }
+            prefix = value;
+        }
+    }
+    if (prefix >= 0) {
+        writer.writeCode(prefix, codeSize);
+    }
+    writer.writeCode(EOI_CODE, codeSize);
+    writer.finish();
+}
+
+}
+
+bool GifWriter::open(const std::string& path, double fps, cv::Size size) {
+    _stream.open(path, std::ios::binary | std::ios::trunc);
+    if (!_stream.is_open()) {
+        return false;
+    }
+    _size = size;
+    _fps = fps;
+    usePool(_indices);
+    // browsers clamp delays below 2cs, so frames are dropped to stay at or below 50 fps
+    _frameStep = std::max(1, (int) std::ceil(fps * 2.0 / 100.0 - 1e-6));
+    _inputIndex = 0;
+    _emittedIndex = 0;
+
+    // header and logical screen descriptor without global color table
+    _stream.write("GIF89a", 6);
+    putShort(_stream, size.width);
+    putShort(_stream, size.height);
+    _stream.put(0);
+    _stream.put(0);
+    _stream.put(0);
+    // infinite looping
+    _stream.put((char) 0x21);
+    _stream.put((char) 0xff);
+    _stream.put(11);
+    _stream.write("NETSCAPE2.0", 11);
+    _stream.put(3);
+    _stream.put(1);
+    putShort(_stream, 0);
+    _stream.put(0);
+
+    return _stream.good();
+}
+
+bool GifWriter::usesStaticFrame() const {
+    return true;
+}
+
+void GifWriter::setStaticFrame(const cv::Mat& frame, const cv::Mat& staticMask) {
+    CV_Assert(frame.type() == CV_8UC3 && staticMask.type() == CV_8UC1 && frame.size() == staticMask.size());
+    cv::Mat dynamicMask = staticMask == 0;
+    _dynamicRect = cv::boundingRect(dynamicMask);
+    bool hasDynamic = !_dynamicRect.empty();
+    if (!hasDynamic) {
+        _dynamicRect = {0, 0, 1, 1};
+    }
+
+    // static palette takes half of color table when there are dynamic pixels
+    ColorHistogram histogram;
+    histogram.add(frame, staticMask, 2);
+    _staticPalette = Palette::fromHistogram(histogram, hasDynamic ? 128 : 256);
+    _staticMask = staticMask.clone();
+    _staticIndices.create(frame.size(), CV_8U);
+    PaletteMapper mapper(_staticPalette);
+    for (int y = 0; y < frame.rows; y++) {
+        const auto* src = frame.ptr<cv::Vec3b>(y);
+        const uint8_t* mask = staticMask.ptr<uint8_t>(y);
+        uint8_t* dst = _staticIndices.ptr<uint8_t>(y);
+        for (int x = 0; x < frame.cols; x++) {
+            dst[x] = mask[x] ? mapper.map(src[x][0], src[x][1], src[x][2]) : 0;
+        }
+    }
+    DEBUG_PRINTLN("*** GIF static colors: " << _staticPalette.colors.size() << ", dynamic rect: " << _dynamicRect);
+}
+
+void GifWriter::write(cv::InputArray frame) {
+    cv::Mat bgr = frame.getMat();
+    CV_Assert(bgr.type() == CV_8UC3 && bgr.size() == _size);
+    long index = _inputIndex++;
+    if (index % _frameStep != 0) {
+        return;
+    }
+
+    // delay with cumulative rounding to keep timing drift-free
+    double unit = 100.0 / _fps;
+    long firstInput = _emittedIndex * _frameStep;
+    int delay = (int) (std::lround((firstInput + _frameStep) * unit) - std::lround(firstInput * unit));
+
+    // after first frame only area with dynamic pixels is written, rest persists
+    bool hasStatic = !_staticMask.empty();
+    cv::Rect rect = (_emittedIndex == 0 || !hasStatic) ? cv::Rect({0, 0}, _size) : _dynamicRect;
+    cv::Mat region = bgr(rect);
+    int staticColors = (int) _staticPalette.colors.size();
+
+    // quantize only dynamic pixels using subsampled histogram
+    _histogram.clear();
+    if (hasStatic) {
+        cv::Mat dynamicMask = _staticMask(rect) == 0;
+        _histogram.add(region, dynamicMask, 2);
+    } else {
+        _histogram.add(region, cv::Mat(), 2);
+    }
+    Palette dynamicPalette = Palette::fromHistogram(_histogram, 256 - staticColors);
+    PaletteMapper mapper(dynamicPalette, staticColors);
+
+    _indices.create(rect.size(), CV_8U);
+    for (int y = 0; y < rect.height; y++) {
+        const auto* src = region.ptr<cv::Vec3b>(y);
+        uint8_t* dst = _indices.ptr<uint8_t>(y);
+        if (hasStatic) {
+            const uint8_t* mask = _staticMask.ptr<uint8_t>(rect.y + y) + rect.x;
+            const uint8_t* staticIndices = _staticIndices.ptr<uint8_t>(rect.y + y) + rect.x;
+            for (int x = 0; x < rect.width; x++) {
+                dst[x] = mask[x] ? staticIndices[x] : mapper.map(src[x][0], src[x][1], src[x][2]);
+            }
+        } else {
+            for (int x = 0; x < rect.width; x++) {
+                dst[x] = mapper.map(src[x][0], src[x][1], src[x][2]);
+            }
+        }
+    }
+
+    writeImage(_indices, rect, dynamicPalette, delay);
+    _emittedIndex += 1;
+}
+
+void GifWriter::writeImage(const cv::Mat& indices, cv::Rect rect, const Palette& dynamicPalette, int delay) {
+    // graphic control extension: do not dispose, no transparency
+    _stream.put((char) 0x21);
+    _stream.put((char) 0xf9);
+    _stream.put(4);
+    _stream.put(1 << 2);
+    putShort(_stream, delay);
+    _stream.put(0);
+    _stream.put(0);
+
+    // image descriptor with 256-entry local color table
+    _stream.put((char) 0x2c);
+    putShort(_stream, rect.x);
+    putShort(_stream, rect.y);
+    putShort(_stream, rect.width);
+    putShort(_stream, rect.height);
+    _stream.put((char) (0x80 | 0x07));
+
+    char colorTable[256 * 3] = {0};
+    int offset = 0;
+    for (const Palette* palette : std::initializer_list<const Palette*>{&_staticPalette, &dynamicPalette}) {
+        for (const cv::Vec3b& color : palette->colors) {
+            if (offset >= 256) {
+                break;
+            }
+            colorTable[offset * 3] = (char) color[2];
+            colorTable[offset * 3 + 1] = (char) color[1];
+            colorTable[offset * 3 + 2] = (char) color[0];
+            offset += 1;
+        }
+    }
+    _stream.write(colorTable, sizeof(colorTable));
+
+    lzwEncode(_stream, indices);
+}
+
+bool GifWriter::isOpened() const {
+    return _stream.is_open();
+}
+
+void GifWriter::release() {
+    if (!_stream.is_open()) {
+        return;
+    }
+    _stream.put(0x3b);
+    _stream.close();
+}
+
+std::string GifWriter::backendName() const {
+    return "GIF";
+}
+
+// AnimationWriter
+
+// memory of frames buffered by AnimationWriter
+static constexpr size_t ANIMATION_MAX_BUFFERED_BYTES = 1024 * 1024 * 1024;
+
+bool AnimationWriter::open(const std::string& path, double fps, cv::Size size) {
+#ifdef SF_HAVE_CV_ANIMATION
+    _path = path;
+    _fps = fps;
+    _frames.clear();
+    _maxFrames = std::max((size_t) 1, ANIMATION_MAX_BUFFERED_BYTES / ((size_t) size.area() * 3));
+    _opened = true;
+    return true;
+#else
+    (void) path;
+    (void) fps;
+    (void) size;
+    DEBUG_PRINTLN("*** Animated WebP/APNG output requires OpenCV 4.11+");
+    return false;
+#endif
+}
+
+void AnimationWriter::write(cv::InputArray frame) {
+    if (_frames.size() >= _maxFrames) {
+        _frames.clear();
+        _opened = false;
+        throw std::runtime_error(
+            "Animated WebP/APNG output is limited to " + std::to_string(_maxFrames)
+            + " frames at this size, use GIF or video output for longer recordings"
+        );
+    }
+    cv::Mat copy;
+    usePool(copy);
+    frame.copyTo(copy);
+    _frames.push_back(copy);
+}
+
+bool AnimationWriter::isOpened() const {
+    return _opened;
+}
+
+void AnimationWriter::release() {
+    if (!_opened) {
+        return;
+    }
+    _opened = false;
+#ifdef SF_HAVE_CV_ANIMATION
+    cv::Animation animation;
+    double unit = 1000.0 / _fps;
+    for (size_t i = 0; i < _frames.size(); i++) {
+        animation.durations.push_back((int) (std::lround((i + 1) * unit) - std::lround(i * unit)));
+    }
+    animation.frames = std::move(_frames);
+    if (!cv::imwriteanimation(_path, animation)) {
+        throw std::runtime_error("Unable to write animation " + _path);
+    }
+#endif
+    _frames.clear();
+}
+
+std::string AnimationWriter::backendName() const {
+    return "OpenCV Animation";
+}
+
+// RawVideoWriter
+
+// size of write buffers, each holds at least one frame
+static constexpr size_t RAW_WRITE_BUFFER_BYTES = 32 * 1024 * 1024;
+static const char Y4M_FRAME_HEADER[] = "FRAME\n";
+
+// returns 0 on success, errno otherwise
+static int writeAll(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        data += written;
+        size -= (size_t) written;
+    }
+    return 0;
+}
+
+RawVideoWriter::RawVideoWriter(RawPixelFormat pixelFormat, bool y4m): _pixelFormat(pixelFormat), _y4m(y4m) {}
+
+RawVideoWriter::~RawVideoWriter() {
+    try {
+        release();
+    } catch (const std::exception& e) {
+        DEBUG_PRINTLN("*** Raw video write failed: " << e.what());
+    }
+}
+
+bool RawVideoWriter::open(const std::string& path, double fps, cv::Size size) {
+    _size = size;
+    if (_pixelFormat == RawPixelFormat::I420) {
+        _size = {size.width & ~1, size.height & ~1};
+    }
+    RawVideoFormat format = {_size.width, _size.height, fps, _pixelFormat};
+    if (!format.isValid()) {
+        return false;
+    }
+    _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) {
+        return false;
+    }
+
+    _frameBytes = format.frameBytes() + (_y4m ? sizeof(Y4M_FRAME_HEADER) - 1 : 0);
+    size_t capacity = std::max(_frameBytes, RAW_WRITE_BUFFER_BYTES / _frameBytes * _frameBytes);
+    for (auto& buffer : _buffers) {
+        buffer.resize(capacity);
+    }
+    _current = 0;
+    _used = 0;
+    if (_y4m) {
+        // frame rate as fraction, NTSC rates (e.g. 29.97) are exact with 1001 denominator
+        long num = std::lround(fps * 1000), den = 1000;
+        double ntscRate = fps * 1001 / 1000;
+        if (std::abs(ntscRate - std::round(ntscRate)) < 1e-3 && std::abs(fps - std::round(fps)) > 1e-3) {
+            num = std::lround(ntscRate) * 1000;
+            den = 1001;
+        }
+        long divisor = std::gcd(num, den);
+        std::string header = "YUV4MPEG2 W" + std::to_string(_size.width) + " H" + std::to_string(_size.height)
+            + " F" + std::to_string(num / divisor) + ":" + std::to_string(den / divisor) + " Ip A1:1 C420jpeg\n";
+        if (writeAll(_fd, (const uint8_t*) header.data(), header.size()) != 0) {
+            ::close(_fd);
+            _fd = -1;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void RawVideoWriter::write(cv::InputArray frame) {
+    if (_used + _frameBytes > _buffers[_current].size()) {
+        flush();
+    }
+
+    uint8_t* data = _buffers[_current].data() + _used;
+    if (_y4m) {
+        std::memcpy(data, Y4M_FRAME_HEADER, sizeof(Y4M_FRAME_HEADER) - 1);
+        data += sizeof(Y4M_FRAME_HEADER) - 1;
+    }
+    // frame is converted (or copied) straight into write buffer
+    cv::Mat source = frame.getMat()(cv::Rect(cv::Point(0, 0), _size));
+    if (_pixelFormat == RawPixelFormat::I420) {
+        cv::Mat planes(_size.height * 3 / 2, _size.width, CV_8UC1, data);
+        cv::cvtColor(source, planes, cv::COLOR_BGR2YUV_I420);
+    } else {
+        cv::Mat packed(_size, CV_8UC3, data);
+        source.copyTo(packed);
+    }
+    _used += _frameBytes;
+}
+
+void RawVideoWriter::flush() {
+    waitForWrite();
+    if (_used == 0) {
+        return;
+    }
+    const uint8_t* data = _buffers[_current].data();
+    size_t size = _used;
+    int fd = _fd;
+    ScopedPlacement placement(Stage::Encode);
+    _pendingWrite = std::async(std::launch::async, [fd, data, size]() { return writeAll(fd, data, size); });
+    _current = 1 - _current;
+    _used = 0;
+}
+
+void RawVideoWriter::waitForWrite() {
+    if (!_pendingWrite.valid()) {
+        return;
+    }
+    int error = _pendingWrite.get();
+    if (error != 0) {
+        throw std::runtime_error(std::string("Unable to write raw video: ") + std::strerror(error));
+    }
+}
+
+bool RawVideoWriter::isOpened() const {
+    return _fd >= 0;
+}
+
+void RawVideoWriter::release() {
+    if (_fd < 0) {
+        return;
+    }
+    int fd = _fd;
+    try {
+        flush();
+        waitForWrite();
+    } catch (...) {
+        ::close(fd);
+        _fd = -1;
+        throw;
+    }
+    ::close(fd);
+    _fd = -1;
+}
+
+std::string RawVideoWriter::backendName() const {
+    return _y4m ? "Y4M" : "Raw video";
+}
+
+// ImageWriter
+
+ImageWriter::ImageWriter(std::vector<std::string> paths, std::vector<int> params)
+    : _paths(std::move(paths)), _params(std::move(params)) {}
+
+bool ImageWriter::open(const std::string&, double, cv::Size) {
+    _index = 0;
+    _opened = true;
+    return true;
+}
+
+void ImageWriter::write(cv::InputArray frame) {
+    if (_index >= _paths.size()) {
+        throw std::runtime_error("No output path left for image");
+    }
+    const std::string& path = _paths[_index++];
+    if (!cv::imwrite(path, frame, _params)) {
+        throw std::runtime_error("Unable to write image " + path);
+    }
+}
+
+bool ImageWriter::isOpened() const {
+    return _opened;
+}
+
+void ImageWriter::release() {
+    _opened = false;
+}
+
+std::string ImageWriter::backendName() const {
+    return "OpenCV imwrite";
+}
+
+} // namespace avo
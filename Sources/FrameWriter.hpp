@@ -0,0 +1,194 @@
+#ifndef SCREENFRAMER_FRAMEWRITER_HPP
+#define SCREENFRAMER_FRAMEWRITER_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <future>
+#include <vector>
+#include "Palette.hpp"
+#include "OutputConfig.hpp"
+
+namespace avo {
+
+// Sink of composited BGR output frames
+class FrameWriter {
+public:
+    virtual ~FrameWriter() = default;
+
+    virtual bool open(const std::string& path, double fps, cv::Size size) = 0;
+    virtual void write(cv::InputArray frame) = 0;
+    virtual bool isOpened() const = 0;
+    virtual void release() = 0;
+    virtual std::string backendName() const = 0;
+
+    // true if writer benefits from knowing static part of output (see setStaticFrame)
+    virtual bool usesStaticFrame() const;
+    /**
+     * Hint about pixels, which are identical in every frame
+     * @param frame CV_8UC3 frame with static pixels
+     * @param staticMask CV_8UC1 mask, nonzero for static pixels
+     */
+    virtual void setStaticFrame(const cv::Mat& frame, const cv::Mat& staticMask);
+
+    /**
+     * Creates writer appropriate for output path extension
+     * (.gif, .webp, .apng - animated images, .y4m, .yuv, .bgr - uncompressed video,
+     * anything else - H.264 video)
+     * @param path output path
+     * @param audioSourcePath file, whose audio is copied into video output, empty - no audio
+     * @param crf quality of video encoded with libav (used when audio is copied)
+     */
+    static std::unique_ptr<FrameWriter> create(const std::string& path, const std::string& audioSourcePath = "", int crf = DEFAULT_CRF);
+};
+
+// returns true if path has extension of animated image format
+bool isAnimatedImagePath(const std::string& path);
+
+// H.264 video using cv::VideoWriter
+class VideoFrameWriter: public FrameWriter {
+private:
+    cv::VideoWriter _writer;
+public:
+    bool open(const std::string& path, double fps, cv::Size size) override;
+    void write(cv::InputArray frame) override;
+    bool isOpened() const override;
+    void release() override;
+    std::string backendName() const override;
+};
+
+// H.264 video encoded with libavcodec, muxed together with audio packets copied from source file
+// (requires build with libav, dimensions are rounded down to even numbers).
+// 8-bit frames are converted to limited range BT.601 YUV and tagged so.
+// In deep color mode writes 10-bit 4:2:0 HEVC from CV_16UC3 frames, tagged with given colorimetry.
+class LibavFrameWriter: public FrameWriter {
+private:
+    struct State;
+    std::string _audioSourcePath;
+    int _crf;
+    bool _deepColor;
+    ColorInfo _colorInfo;
+    std::unique_ptr<State> _state;
+public:
+    explicit LibavFrameWriter(std::string audioSourcePath, int crf = DEFAULT_CRF, bool deepColor = false, ColorInfo colorInfo = {});
+    ~LibavFrameWriter() override;
+    // true if libav with H.264 encoder is available
+    static bool isAvailable();
+    // true if libav with HEVC encoder accepting 10-bit frames is available
+    static bool isDeepColorAvailable();
+
+    bool open(const std::string& path, double fps, cv::Size size) override;
+    void write(cv::InputArray frame) override;
+    bool isOpened() const override;
+    void release() override;
+    std::string backendName() const override;
+};
+
+// Animated GIF with static/dynamic palette split
+class GifWriter: public FrameWriter {
+private:
+    std::ofstream _stream;
+    cv::Size _size;
+    double _fps = 0.0;
+    // number of input frames per emitted frame (GIF delays are in centiseconds)
+    int _frameStep = 1;
+    long _inputIndex = 0;
+    long _emittedIndex = 0;
+    // static pixels are mapped once to static palette
+    Palette _staticPalette;
+    cv::Mat _staticIndices;
+    cv::Mat _staticMask;
+    // bounding rect of dynamic pixels, written after first frame
+    cv::Rect _dynamicRect;
+    // per-frame buffers
+    ColorHistogram _histogram;
+    cv::Mat _indices;
+public:
+    bool open(const std::string& path, double fps, cv::Size size) override;
+    void write(cv::InputArray frame) override;
+    bool isOpened() const override;
+    void release() override;
+    std::string backendName() const override;
+    bool usesStaticFrame() const override;
+    void setStaticFrame(const cv::Mat& frame, const cv::Mat& staticMask) override;
+private:
+    void writeImage(const cv::Mat& indices, cv::Rect rect, const Palette& dynamicPalette, int delay);
+};
+
+// Animated WebP/APNG using OpenCV animation codecs (requires OpenCV 4.11+)
+// Frames are kept in memory and encoded on release
+class AnimationWriter: public FrameWriter {
+private:
+    std::string _path;
+    double _fps = 0.0;
+    bool _opened = false;
+    // frames are buffered until release, as encoder takes whole animation at once
+    std::vector<cv::Mat> _frames;
+    size_t _maxFrames = 0;
+public:
+    bool open(const std::string& path, double fps, cv::Size size) override;
+    void write(cv::InputArray frame) override;
+    bool isOpened() const override;
+    void release() override;
+    std::string backendName() const override;
+};
+
+// Uncompressed video: Y4M (4:2:0) or headerless raw frames (I420 or BGR24)
+// Frames are collected in large buffers, which are written by background thread
+// (dimensions of 4:2:0 outputs are rounded down to even numbers)
+class RawVideoWriter: public FrameWriter {
+private:
+    RawPixelFormat _pixelFormat;
+    bool _y4m;
+    int _fd = -1;
+    cv::Size _size;
+    size_t _frameBytes = 0;
+    // buffer being filled, and buffer being written
+    std::vector<uint8_t> _buffers[2];
+    int _current = 0;
+    size_t _used = 0;
+    // errno of background write, 0 on success
+    std::future<int> _pendingWrite;
+public:
+    RawVideoWriter(RawPixelFormat pixelFormat, bool y4m);
+    ~RawVideoWriter() override;
+
+    bool open(const std::string& path, double fps, cv::Size size) override;
+    void write(cv::InputArray frame) override;
+    bool isOpened() const override;
+    void release() override;
+    std::string backendName() const override;
+private:
+    // passes filled buffer to background write, after previous write is finished
+    void flush();
+    // waits for background write, throws if it failed
+    void waitForWrite();
+};
+
+// Still images encoded with cv::imwrite, n-th written frame is stored at n-th path
+// (path given to open is ignored)
+class ImageWriter: public FrameWriter {
+private:
+    std::vector<std::string> _paths;
+    std::vector<int> _params;
+    size_t _index = 0;
+    bool _opened = false;
+public:
+    /**
+     * @param paths output paths, format is selected by extension
+     * @param params cv::imwrite parameters, e.g. {cv::IMWRITE_PNG_COMPRESSION, 3}
+     */
+    explicit ImageWriter(std::vector<std::string> paths, std::vector<int> params = {});
+
+    bool open(const std::string& path, double fps, cv::Size size) override;
+    void write(cv::InputArray frame) override;
+    bool isOpened() const override;
+    void release() override;
+    std::string backendName() const override;
+};
+
+} // namespace avo
+
+#endif //SCREENFRAMER_FRAMEWRITER_HPP
@@ -0,0 +1,731 @@
+#include "Job.hpp"
+#include "Utility.hpp"
+#include "Debug.hpp"
+#include "RawVideo.hpp"
+#include "DeepVideo.hpp"
+#include "FrameWriter.hpp"
+#include "Remux.hpp"
+#include <cmath>
+#include <cctype>
+#include <cstring>
+#include <thread>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <glob.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+#include <opencv2/core/ocl.hpp>
+
+namespace fs = std::filesystem;
+
+// JobRequest
+
+void to_json(json& j, const JobRequest& request) {
+    j = json{
+        {"input", request.inputPath},
+        {"output", request.outputPath},
+        {"template", request.templateKey},
+        {"width", request.width},
+        {"height", request.height},
+        {"padding", request.padding},
+        {"color", request.color},
+        {"backgroundImage", request.backgroundImage},
+        {"gradient", request.gradient},
+        {"shadow", request.shadow},
+        {"segments", request.segments},
+        {"backend", request.backend},
+        {"compact", request.compactMemory},
+        {"scaleFilter", request.scaleFilter},
+        {"scaleAtDecode", request.scaleAtDecode},
+        {"rotation", request.rotation},
+        {"audio", request.copyAudio},
+        {"crf", request.crf},
+        {"pngCompression", request.pngCompression},
+        {"scene", request.scene},
+        {"rawInput", request.rawInput},
+        {"previewTime", request.previewTime},
+        {"previewDuration", request.previewDuration},
+        {"previewScale", request.previewScale},
+        {"deepColor", request.deepColor}
+    };
+}
+
+void from_json(const json& j, JobRequest& request) {
+    j.at("input").get_to(request.inputPath);
+    j.at("output").get_to(request.outputPath);
+    request.templateKey = j.value("template", request.templateKey);
+    request.width = j.value("width", request.width);
+    request.height = j.value("height", request.height);
+    request.padding = j.value("padding", request.padding);
+    request.color = j.value("color", request.color);
+    request.backgroundImage = j.value("backgroundImage", request.backgroundImage);
+    request.gradient = j.value("gradient", request.gradient);
+    request.shadow = j.value("shadow", request.shadow);
+    request.segments = j.value("segments", request.segments);
+    request.backend = j.value("backend", request.backend);
+    request.compactMemory = j.value("compact", request.compactMemory);
+    request.scaleFilter = j.value("scaleFilter", request.scaleFilter);
+    request.scaleAtDecode = j.value("scaleAtDecode", request.scaleAtDecode);
+    request.rotation = j.value("rotation", request.rotation);
+    request.copyAudio = j.value("audio", request.copyAudio);
+    request.crf = j.value("crf", request.crf);
+    request.pngCompression = j.value("pngCompression", request.pngCompression);
+    request.scene = j.value("scene", request.scene);
+    request.rawInput = j.value("rawInput", request.rawInput);
+    request.previewTime = j.value("previewTime", request.previewTime);
+    request.previewDuration = j.value("previewDuration", request.previewDuration);
+    request.previewScale = j.value("previewScale", request.previewScale);
+    request.deepColor = j.value("deepColor", request.deepColor);
+}
+
+bool JobRequest::isPreview() const {
+    return previewTime >= 0.0;
+}
+
+// JobError
+
+JobError::JobError(int code, const std::string& message): std::runtime_error(message), _code(code) {}
+
+int JobError::code() const {
+    return _code;
+}
+
+// Job resolution
+
+static std::string lowercaseExtension(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext;
+}
+
+// parses WIDTHxHEIGHT@FPS geometry of headerless raw video, pixel format follows path extension
+static avo::RawVideoFormat parseRawVideoFormat(const std::string& str, const std::string& path) {
+    avo::RawVideoFormat format;
+    format.pixelFormat = avo::rawPixelFormatOf(path);
+    char separator = 0, at = 0;
+    std::istringstream stream(str);
+    stream >> format.width >> separator >> format.height >> at >> format.fps;
+    if (stream.fail() || separator != 'x' || at != '@' || !format.isValid()) {
+        throw JobError(1, "Invalid raw input format \"" + str + "\", expected WIDTHxHEIGHT@FPS (even dimensions for .yuv)");
+    }
+    return format;
+}
+
+// probes Y4M or raw input without decoding
+static InputInfo probeRawVideo(const JobRequest& request, avo::RawVideoFormat& rawFormat) {
+    try {
+        if (avo::isHeaderlessRawVideoPath(request.inputPath)) {
+            if (request.rawInput.empty()) {
+                throw JobError(1, "Raw input requires its geometry (--raw-input WIDTHxHEIGHT@FPS)");
+            }
+            rawFormat = parseRawVideoFormat(request.rawInput, request.inputPath);
+        }
+        avo::RawVideoFormat format = rawFormat.isValid()
+            ? avo::MappedVideo(request.inputPath, rawFormat).format()
+            : avo::MappedVideo(request.inputPath).format();
+        DEBUG_PRINTLN("*** Raw input: [" << format.width << ", " << format.height << "], fps: " << format.fps);
+        return {format.width, format.height, format.fps, 0};
+    } catch (const JobError&) {
+        throw;
+    } catch (const std::exception& e) {
+        throw JobError(2, e.what());
+    }
+}
+
+ResolvedJob resolveJob(const JobRequest& request, const json& contents) {
+    // check if input file exists
+    if (!fs::exists(request.inputPath)) {
+        throw JobError(2, "Input video file does not exist at: " + request.inputPath);
+    }
+
+    // uncompressed inputs have no audio nor rotation metadata
+    if (avo::isRawVideoPath(request.inputPath)) {
+        if (request.deepColor) {
+            throw JobError(1, "10-bit output is not supported for uncompressed input");
+        }
+        avo::RawVideoFormat rawFormat;
+        InputInfo input = probeRawVideo(request, rawFormat);
+        JobRequest rawRequest = request;
+        rawRequest.copyAudio = false;
+        ResolvedJob job = resolveJob(rawRequest, contents, input);
+        job.outputConfig.rawInputFormat = rawFormat;
+        return job;
+    }
+
+    // probe input video
+    cv::VideoCapture cap(request.inputPath);
+    int totalFrames = (int) cap.get(cv::CAP_PROP_FRAME_COUNT);
+    InputInfo input;
+    input.width = (int) cap.get(cv::CAP_PROP_FRAME_WIDTH);
+    input.height = (int) cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+    input.fps = cap.get(cv::CAP_PROP_FPS);
+    cap.release();
+    DEBUG_PRINTLN("*** Total frames: " << totalFrames << ", fps: " << input.fps);
+    DEBUG_PRINTLN("*** Input frame dimensions: [" << input.width << ", " << input.height << "]");
+
+    // orientation, probed dimensions are already in display orientation (after metadata rotation)
+    input.frameRotation = avo::probeFrameRotation(request.inputPath);
+
+    ResolvedJob job = resolveJob(request, contents, input);
+    // OpenCV decodes 8-bit frames only, bit depth and colorimetry come from stream parameters
+    if (avo::hasRemuxSupport()) {
+        try {
+            avo::VideoColorFormat format = avo::probeVideoColorFormat(request.inputPath);
+            job.inputBitDepth = format.bitDepth;
+            job.outputConfig.colorInfo = format.colorInfo;
+        } catch (const std::exception& e) {
+            DEBUG_PRINTLN("*** Unable to probe color format: " << e.what());
+        }
+    }
+    return job;
+}
+
+// background layers drawn below device frame
+static avo::Background resolveBackground(const JobRequest& request) {
+    avo::Background background;
+    if (!request.backgroundImage.empty()) {
+        if (!fs::exists(request.backgroundImage)) {
+            throw JobError(2, "Background image does not exist at: " + request.backgroundImage);
+        }
+        background.imagePath = request.backgroundImage;
+    }
+    try {
+        if (!request.gradient.empty()) {
+            avo::parseGradient(request.gradient, background);
+        }
+    } catch (const std::exception&) {
+        throw JobError(1, "Invalid gradient \"" + request.gradient + "\", expected linear:#RRGGBB[:ANGLE] or radial:#RRGGBB");
+    }
+    try {
+        if (!request.shadow.empty()) {
+            avo::parseShadow(request.shadow, background);
+        }
+    } catch (const std::exception&) {
+        throw JobError(1, "Invalid shadow \"" + request.shadow + "\", expected BLUR[:OFFSETX:OFFSETY[:OPACITY]]");
+    }
+    return background;
+}
+
+ResolvedJob resolveJob(const JobRequest& request, const json& contents, const InputInfo& input) {
+    if (request.backend != "cpu" && request.backend != "opencl") {
+        throw JobError(1, "Unknown backend \"" + request.backend + "\"");
+    }
+    if (request.compactMemory && request.backend != "cpu") {
+        throw JobError(1, "Compact memory mode is supported only by cpu backend");
+    }
+    avo::RGBColor backgroundColor;
+    try {
+        backgroundColor = {request.color};
+    } catch (const std::exception&) {
+        throw JobError(1, "Invalid color \"" + request.color + "\"");
+    }
+    avo::ScaleFilter scaleFilter;
+    try {
+        scaleFilter = avo::parseScaleFilter(request.scaleFilter);
+    } catch (const std::exception& e) {
+        throw JobError(1, e.what());
+    }
+
+    int inputWidth = input.width, inputHeight = input.height;
+    int frameRotation = input.frameRotation;
+    int templateRotation;
+    if (request.rotation == "auto") {
+        // templates are portrait, landscape videos are put in device rotated counter-clockwise
+        templateRotation = inputWidth > inputHeight ? 270 : 0;
+    } else {
+        try {
+            templateRotation = avo::normalizeRotation(std::stoi(request.rotation));
+        } catch (const std::exception&) {
+            templateRotation = -1;
+        }
+        if (templateRotation < 0) {
+            throw JobError(1, "Invalid rotation \"" + request.rotation + "\", expected auto, 0, 90, 180 or 270");
+        }
+    }
+    bool landscapeTemplate = templateRotation % 180 != 0;
+    DEBUG_PRINTLN("*** Frame rotation: " << frameRotation << ", template rotation: " << templateRotation);
+
+    // parse template config
+    avo::OverlayConfig config;
+    bool templateDetected = request.templateKey == "auto";
+    if (templateDetected) {
+        // automatic template selection, in template orientation
+        std::vector<ContentsEntry> entries;
+        for (auto it = contents.begin(); it != contents.end(); ++it) {
+            entries.push_back(it.value().get<ContentsEntry>());
+        }
+        int index = landscapeTemplate
+            ? autoTemplate(entries, inputHeight, inputWidth)
+            : autoTemplate(entries, inputWidth, inputHeight);
+        entries[index].toOverlayConfig(config);
+    } else {
+        try {
+            auto result = parseTemplateKey(request.templateKey);
+            auto deviceKey = std::get<0>(result);
+            auto colorKey = std::get<1>(result);
+            if (!contents.contains(deviceKey)) {
+                throw std::runtime_error("Invalid device key \"" + deviceKey + "\"");
+            }
+
+            auto entry = contents.at(deviceKey).get<ContentsEntry>();
+            entry.toOverlayConfig(config, colorKey);
+        } catch (const std::exception& e) {
+            throw JobError(3, e.what());
+        }
+    }
+    if (!config.isValid()) {
+        throw JobError(3, "Invalid template configuration for " + config.imagePath);
+    }
+    DEBUG_PRINTLN("*** Config: path - " << config.imagePath << ", ox - " << config.screenLeft << ", oy - " << config.screenTop);
+    DEBUG_PRINTLN("***         width - " << config.templateWidth << ", height - " << config.templateHeight);
+    // output dimensions follow rotated template, overlayer rotates its images itself
+    avo::OverlayConfig rotatedConfig = config.rotated(templateRotation);
+
+    // padding setup
+    std::tuple<double, double> padding;
+    if (!parsePadding(request.padding, padding, {rotatedConfig.templateWidth, rotatedConfig.templateHeight})) {
+        throw JobError(4, "Invalid padding string " + request.padding);
+    }
+    double pH = std::get<0>(padding), pV = std::get<1>(padding);
+    DEBUG_PRINTLN("*** Parsed padding: pH " << pH << ", pV " << pV);
+
+    // only one of width,height nonzero values is used to retain proper aspect ratio
+    int width = request.width, height = request.height;
+    int templateWidth = rotatedConfig.templateWidth, templateHeight = rotatedConfig.templateHeight;
+    if (width > 0) {
+        double f = (double) width / (templateWidth + 2 * pH * templateWidth);
+        height = (int) round(f * (templateHeight + 2 * pV * templateHeight));
+    } else if (height > 0) {
+        double f = (double) height / (templateHeight + 2 * pV * templateHeight);
+        width = (int) round(f * (templateWidth + 2 * pH * templateWidth));
+    } else {
+        width = templateWidth + (int) (2 * pH * templateWidth);
+        height = templateHeight + (int) (2 * pV * templateHeight);
+    }
+    DEBUG_PRINTLN("*** Output frame dimensions: [" << width << ", " << height << "]");
+
+    avo::OutputConfig output(request.outputPath, input.fps, width, height, pH, pV, backgroundColor);
+    output.background = resolveBackground(request);
+    output.compactMemory = request.compactMemory;
+    output.scaleFilter = scaleFilter;
+    output.scaleAtDecode = request.scaleAtDecode;
+    output.templateRotation = templateRotation;
+    output.frameRotation = frameRotation;
+    if (request.copyAudio) {
+        output.audioSourcePath = request.inputPath;
+    }
+    if (request.crf < 0 || request.crf > 51) {
+        throw JobError(1, "Invalid CRF " + std::to_string(request.crf) + ", expected 0-51");
+    }
+    output.crf = request.crf;
+    if (request.deepColor) {
+        if (!avo::LibavFrameWriter::isDeepColorAvailable()) {
+            throw JobError(1, "10-bit output requires build with libav and HEVC encoder (e.g. libx265)");
+        }
+        if (request.backend != "cpu") {
+            throw JobError(1, "10-bit output is supported only by cpu backend");
+        }
+        std::string ext = lowercaseExtension(request.outputPath);
+        if (ext != ".mp4" && ext != ".mov" && ext != ".mkv") {
+            throw JobError(1, "10-bit output path must have .mp4, .mov or .mkv extension");
+        }
+        // 16-bit frames are blended in place, float buffers would not fit 16-bit range anyway
+        output.deepColor = true;
+        output.compactMemory = true;
+    }
+
+    ResolvedJob job = {request, config, output, templateDetected};
+    if (job.request.segments <= 0) {
+        job.request.segments = (int) std::max(1u, std::thread::hardware_concurrency());
+    }
+    return job;
+}
+
+// Job rendering
+
+// selects OpenCL usage for calling thread, returns true if OpenCL is used
+static bool selectBackend(const JobRequest& request) {
+    // OpenCL (T-API) setup, device can be chosen with OPENCV_OPENCL_DEVICE (e.g. ":CPU:" for POCL)
+    bool useOpenCL = request.backend == "opencl";
+    if (useOpenCL && !cv::ocl::haveOpenCL()) {
+        throw JobError(1, "OpenCL is not available");
+    }
+    cv::ocl::setUseOpenCL(useOpenCL);
+    return useOpenCL;
+}
+
+avo::RenderStats renderJob(const ResolvedJob& job, avo::Overlayer& overlayer, const avo::ProgressCallback& progress) {
+    bool useOpenCL = selectBackend(job.request);
+    const std::string& inputPath = job.request.inputPath;
+    int segments = job.request.segments;
+    if (useOpenCL) {
+        return avo::renderVideoSegmented<cv::UMat>(overlayer, inputPath, job.outputConfig, segments, progress);
+    }
+    return avo::renderVideoSegmented<cv::Mat>(overlayer, inputPath, job.outputConfig, segments, progress);
+}
+
+// Image mode
+
+static bool isImagePath(const fs::path& path) {
+    std::string ext = lowercaseExtension(path);
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg";
+}
+
+static bool isGlobPattern(const std::string& path) {
+    return path.find_first_of("*?[") != std::string::npos;
+}
+
+bool isImageInput(const std::string& inputPath) {
+    if (isGlobPattern(inputPath) && !fs::exists(inputPath)) {
+        return true;
+    }
+
+    return fs::is_directory(inputPath) || isImagePath(inputPath);
+}
+
+std::vector<std::string> listImageInputs(const std::string& inputPath) {
+    std::vector<std::string> paths;
+    if (fs::is_directory(inputPath)) {
+        for (const auto& entry : fs::directory_iterator(inputPath)) {
+            if (entry.is_regular_file() && isImagePath(entry.path())) {
+                paths.push_back(entry.path().string());
+            }
+        }
+    } else if (fs::exists(inputPath)) {
+        paths.push_back(inputPath);
+    } else {
+        glob_t result;
+        if (glob(inputPath.c_str(), 0, nullptr, &result) == 0) {
+            for (size_t i = 0; i < result.gl_pathc; i++) {
+                if (isImagePath(result.gl_pathv[i]) && fs::is_regular_file(result.gl_pathv[i])) {
+                    paths.emplace_back(result.gl_pathv[i]);
+                }
+            }
+        }
+        globfree(&result);
+    }
+    std::sort(paths.begin(), paths.end());
+
+    return paths;
+}
+
+static uint32_t readBigEndian(const unsigned char* bytes, int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++) {
+        value = (value << 8u) | bytes[i];
+    }
+    return value;
+}
+
+static uint32_t readEndian(const unsigned char* bytes, int count, bool littleEndian) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++) {
+        value = (value << 8u) | bytes[littleEndian ? count - 1 - i : i];
+    }
+    return value;
+}
+
+// EXIF orientation (1-8) of JPEG APP1 segment contents, 0 if segment has none
+static int readExifOrientation(const std::vector<unsigned char>& segment) {
+    // "Exif\0\0" followed by TIFF header and first IFD
+    const size_t tiff = 6;
+    if (segment.size() < tiff + 8 || std::memcmp(segment.data(), "Exif\0\0", 6) != 0) {
+        return 0;
+    }
+    const unsigned char* data = segment.data() + tiff;
+    size_t size = segment.size() - tiff;
+    bool littleEndian = data[0] == 'I' && data[1] == 'I';
+    size_t ifd = readEndian(data + 4, 4, littleEndian);
+    if (ifd + 2 > size) {
+        return 0;
+    }
+    size_t entries = readEndian(data + ifd, 2, littleEndian);
+    for (size_t i = 0; i < entries && ifd + 2 + (i + 1) * 12 <= size; i++) {
+        const unsigned char* entry = data + ifd + 2 + i * 12;
+        if (readEndian(entry, 2, littleEndian) == 0x0112) {
+            int orientation = (int) readEndian(entry + 8, 2, littleEndian);
+            return orientation >= 1 && orientation <= 8 ? orientation : 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reads image dimensions from PNG or JPEG header, without decoding pixels
+ * (other files are decoded). Dimensions are in display orientation, as cv::imread
+ * applies JPEG EXIF orientation.
+ */
+static cv::Size probeImageSize(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    unsigned char header[24];
+    if (file.read((char*) header, sizeof(header))) {
+        static const unsigned char pngSignature[8] = {0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a};
+        if (std::memcmp(header, pngSignature, 8) == 0 && std::memcmp(header + 12, "IHDR", 4) == 0) {
+            return {(int) readBigEndian(header + 16, 4), (int) readBigEndian(header + 20, 4)};
+        }
+
+        if (header[0] == 0xff && header[1] == 0xd8) {
+            // walk JPEG segments until start of frame
+            file.seekg(2);
+            int marker;
+            int orientation = 1;
+            while (file.get() == 0xff) {
+                do {
+                    marker = file.get();
+                } while (marker == 0xff);
+                if (marker == EOF || marker == 0xd9 || marker == 0xda) {
+                    break;
+                }
+                if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8)) {
+                    continue;
+                }
+                unsigned char segment[7];
+                if (!file.read((char*) segment, 2)) {
+                    break;
+                }
+                int length = (int) readBigEndian(segment, 2);
+                bool startOfFrame = marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc;
+                if (startOfFrame) {
+                    if (!file.read((char*) segment + 2, 5)) {
+                        break;
+                    }
+                    cv::Size size((int) readBigEndian(segment + 5, 2), (int) readBigEndian(segment + 3, 2));
+                    // orientations 5-8 transpose image
+                    return orientation >= 5 ? cv::Size(size.height, size.width) : size;
+                }
+                if (marker == 0xe1 && length > 2) {
+                    std::vector<unsigned char> contents((size_t) length - 2);
+                    if (!file.read((char*) contents.data(), (std::streamsize) contents.size())) {
+                        break;
+                    }
+                    // other APP1 segments (e.g. XMP) have no orientation
+                    int exifOrientation = readExifOrientation(contents);
+                    orientation = exifOrientation > 0 ? exifOrientation : orientation;
+                    continue;
+                }
+                file.seekg(length - 2, std::ios::cur);
+            }
+        }
+    }
+
+    return cv::imread(path, cv::IMREAD_COLOR).size();
+}
+
+// orders sizes for use as map key
+struct SizeLess {
+    bool operator()(const cv::Size& a, const cv::Size& b) const {
+        return a.width != b.width ? a.width < b.width : a.height < b.height;
+    }
+};
+
+avo::RenderStats renderImageJob(
+    const JobRequest& request,
+    const json& contents,
+    const OverlayerProvider& overlayerFor,
+    const avo::ProgressCallback& progress
+) {
+    if (request.isPreview()) {
+        throw JobError(1, "Preview is supported only for video input");
+    }
+    if (request.pngCompression < 0 || request.pngCompression > 9) {
+        throw JobError(1, "Invalid PNG compression level " + std::to_string(request.pngCompression) + ", expected 0-9");
+    }
+    std::vector<std::string> inputs = listImageInputs(request.inputPath);
+    if (inputs.empty()) {
+        throw JobError(2, "No PNG or JPEG images found at: " + request.inputPath);
+    }
+
+    // single image may be written to given image path, otherwise output is a directory
+    bool singleOutput = inputs.size() == 1 && !fs::is_directory(request.inputPath)
+        && isImagePath(request.outputPath) && !fs::is_directory(request.outputPath);
+    if (!singleOutput) {
+        fs::create_directories(request.outputPath);
+    }
+
+    // group by resolution, so that images of every group share template and task geometry
+    std::map<cv::Size, std::vector<avo::ImageItem>, SizeLess> groups;
+    std::set<std::string> outputPaths;
+    for (const auto& input : inputs) {
+        cv::Size size = probeImageSize(input);
+        if (size.empty()) {
+            throw JobError(2, "Unable to read image " + input);
+        }
+        std::string output = singleOutput
+            ? request.outputPath
+            : (fs::path(request.outputPath) / fs::path(input).filename().replace_extension(".png")).string();
+        if (!outputPaths.insert(output).second) {
+            throw JobError(1, "Multiple input images map to output " + output);
+        }
+        groups[size].push_back({input, output});
+    }
+    DEBUG_PRINTLN("*** Images: " << inputs.size() << ", resolutions: " << groups.size());
+
+    bool useOpenCL = selectBackend(request);
+    int workerCount = request.segments > 0 ? request.segments : (int) std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> writeParams = {cv::IMWRITE_PNG_COMPRESSION, request.pngCompression};
+    int totalImages = (int) inputs.size(), doneImages = 0;
+    avo::RenderStats stats;
+    for (const auto& [size, items] : groups) {
+        // images are still, so there is no frame rate or rotation metadata
+        ResolvedJob job = resolveJob(request, contents, {size.width, size.height, 1.0, 0});
+        job.outputConfig.audioSourcePath.clear();
+        DEBUG_PRINTLN("*** Group [" << size.width << ", " << size.height << "]: " << items.size()
+                      << " images, template " << job.overlayConfig.imagePath);
+        auto overlayer = overlayerFor(job.overlayConfig);
+
+        avo::ProgressCallback groupProgress;
+        if (progress) {
+            groupProgress = [&](int index, int) { progress(doneImages + index, totalImages); };
+        }
+        avo::RenderStats groupStats = useOpenCL
+            ? avo::renderImages<cv::UMat>(*overlayer, items, job.outputConfig, workerCount, writeParams, groupProgress)
+            : avo::renderImages<cv::Mat>(*overlayer, items, job.outputConfig, workerCount, writeParams, groupProgress);
+        doneImages += (int) items.size();
+        stats.frameCount += groupStats.frameCount;
+        stats.taskAllocatedBytes = std::max(stats.taskAllocatedBytes, groupStats.taskAllocatedBytes);
+    }
+
+    return stats;
+}
+
+// Scene mode
+
+ResolvedScene resolveScene(const JobRequest& request, const json& contents) {
+    if (request.deepColor) {
+        throw JobError(1, "10-bit output is not supported in scene mode");
+    }
+    if (request.isPreview()) {
+        throw JobError(1, "Preview is not supported in scene mode");
+    }
+    std::ifstream file(request.inputPath);
+    if (!file.is_open()) {
+        throw JobError(2, "Scene description does not exist at: " + request.inputPath);
+    }
+    json description;
+    try {
+        file >> description;
+        if (!description.at("slots").is_array() || description.at("slots").empty()) {
+            throw std::invalid_argument("scene has no slots");
+        }
+    } catch (const std::exception& e) {
+        throw JobError(1, std::string("Invalid scene description: ") + e.what());
+    }
+
+    std::vector<ResolvedJob> slots;
+    std::vector<cv::Point> origins;
+    std::string color = description.value("color", request.color);
+    fs::path baseDirectory = fs::path(request.inputPath).parent_path();
+    int canvasWidth = 0, canvasHeight = 0;
+    for (const auto& slot : description.at("slots")) {
+        JobRequest slotRequest = request;
+        cv::Point origin;
+        try {
+            slotRequest.inputPath = (baseDirectory / slot.at("input").get<std::string>()).string();
+            slotRequest.templateKey = slot.value("template", std::string("auto"));
+            slotRequest.width = slot.value("width", 0);
+            slotRequest.height = slot.value("height", 0);
+            slotRequest.rotation = slot.value("rotation", request.rotation);
+            origin = {slot.value("x", 0), slot.value("y", 0)};
+        } catch (const std::exception& e) {
+            throw JobError(1, std::string("Invalid scene slot: ") + e.what());
+        }
+        // device frame fills whole slot, background is drawn once for whole scene
+        slotRequest.padding = "0.0";
+        slotRequest.color = color;
+        slotRequest.backgroundImage.clear();
+        slotRequest.gradient.clear();
+        slotRequest.shadow.clear();
+        slotRequest.copyAudio = false;
+        if (origin.x < 0 || origin.y < 0) {
+            throw JobError(1, "Scene slot of " + slotRequest.inputPath + " has negative position");
+        }
+
+        ResolvedJob job = resolveJob(slotRequest, contents);
+        canvasWidth = std::max(canvasWidth, origin.x + job.outputConfig.width);
+        canvasHeight = std::max(canvasHeight, origin.y + job.outputConfig.height);
+        slots.push_back(job);
+        origins.push_back(origin);
+    }
+
+    int width = description.value("width", canvasWidth);
+    int height = description.value("height", canvasHeight);
+    if (width < canvasWidth || height < canvasHeight) {
+        throw JobError(4, "Scene slots do not fit in " + std::to_string(width) + "x" + std::to_string(height) + " canvas");
+    }
+    double fps = description.value("fps", slots.front().outputConfig.fps);
+    // index of slot, whose audio is copied into output (-1 - none)
+    int audioSlot = description.value("audio", request.copyAudio ? 0 : -1);
+    if (audioSlot >= (int) slots.size()) {
+        throw JobError(1, "Invalid audio slot " + std::to_string(audioSlot));
+    }
+
+    // color was validated with slots
+    avo::OutputConfig output(request.outputPath, fps, width, height, 0.0, 0.0, avo::RGBColor(color));
+    output.background = resolveBackground(request);
+    if (audioSlot >= 0) {
+        output.audioSourcePath = slots[audioSlot].request.inputPath;
+    }
+    // crf was validated with slots
+    output.crf = request.crf;
+    if (!output.isValid()) {
+        throw JobError(1, "Invalid scene output configuration");
+    }
+    DEBUG_PRINTLN("*** Scene: " << slots.size() << " slots, canvas [" << width << ", " << height << "], fps " << fps);
+
+    return {request, slots, origins, output};
+}
+
+avo::RenderStats renderSceneJob(
+    const ResolvedScene& scene,
+    const OverlayerProvider& overlayerFor,
+    const avo::ProgressCallback& progress
+) {
+    bool useOpenCL = selectBackend(scene.request);
+    std::vector<avo::SceneSlot> slots;
+    for (size_t i = 0; i < scene.slots.size(); i++) {
+        const ResolvedJob& job = scene.slots[i];
+        slots.push_back({job.request.inputPath, overlayerFor(job.overlayConfig), job.outputConfig, scene.origins[i]});
+    }
+    if (useOpenCL) {
+        return avo::renderScene<cv::UMat>(slots, scene.outputConfig, progress);
+    }
+    return avo::renderScene<cv::Mat>(slots, scene.outputConfig, progress);
+}
+
+// Preview
+
+avo::RenderStats renderPreviewJob(const ResolvedJob& job, avo::Overlayer& overlayer, const avo::ProgressCallback& progress) {
+    const JobRequest& request = job.request;
+    if (request.previewScale <= 0.0 || request.previewScale > 1.0) {
+        throw JobError(1, "Preview scale must be in (0, 1] range");
+    }
+    if (request.previewDuration < 0.0) {
+        throw JobError(1, "Preview duration must not be negative");
+    }
+    if (request.previewDuration == 0.0 && !isImagePath(request.outputPath)) {
+        throw JobError(1, "Preview frame is written as image, output path must have .png, .jpg or .jpeg extension");
+    }
+
+    // even dimensions, as required by video encoders
+    avo::OutputConfig output = job.outputConfig;
+    output.width = std::max(2, (int) std::lround(output.width * request.previewScale / 2.0) * 2);
+    output.height = std::max(2, (int) std::lround(output.height * request.previewScale / 2.0) * 2);
+    output.audioSourcePath.clear();
+    // previews are decoded and written with 8 bits
+    output.deepColor = false;
+    bool useOpenCL = selectBackend(request);
+    // 8-bit buffers and single blend of static area, only screen area is blended per frame
+    output.compactMemory = output.compactMemory || !useOpenCL;
+    DEBUG_PRINTLN("*** Preview at " << request.previewTime << " s: [" << output.width << ", " << output.height << "]");
+
+    std::vector<int> writeParams = {cv::IMWRITE_PNG_COMPRESSION, request.pngCompression};
+    double seconds = request.previewTime, duration = request.previewDuration;
+    if (useOpenCL) {
+        return avo::renderPreview<cv::UMat>(overlayer, request.inputPath, output, seconds, duration, writeParams, progress);
+    }
+    return avo::renderPreview<cv::Mat>(overlayer, request.inputPath, output, seconds, duration, writeParams, progress);
+}
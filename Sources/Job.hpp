@@ -0,0 +1,179 @@
+#ifndef SCREENFRAMER_JOB_HPP
+#define SCREENFRAMER_JOB_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+#include "Overlayer.hpp"
+#include "Renderer.hpp"
+
+using nlohmann::json;
+
+// Parameters of single overlay job, as given on command line or in daemon request
+struct JobRequest {
+    std::string inputPath;
+    std::string outputPath;
+    std::string templateKey = "auto";
+    int width = 0;
+    int height = 0;
+    std::string padding = "0.16:";
+    std::string color = "#000000";
+    // background image, gradient (TYPE:#RRGGBB[:ANGLE]) and device drop shadow (BLUR[:X:Y[:OPACITY]]), empty - none
+    std::string backgroundImage;
+    std::string gradient;
+    std::string shadow;
+    // 0 - number of cores
+    int segments = 1;
+    std::string backend = "cpu";
+    bool compactMemory = false;
+    std::string scaleFilter = "bilinear";
+    bool scaleAtDecode = false;
+    // clockwise rotation of device template in degrees, "auto" - landscape device for landscape video
+    std::string rotation = "auto";
+    // copy audio of input into output video
+    bool copyAudio = true;
+    // constant rate factor (0-51, lower is better) of video encoded with libav, when audio is copied
+    int crf = avo::DEFAULT_CRF;
+    // zlib compression level (0-9) of PNG outputs in image mode
+    int pngCompression = 3;
+    // input path is scene description (JSON) with multiple device slots
+    bool scene = false;
+    // geometry of headerless raw input (.yuv, .bgr) as WIDTHxHEIGHT@FPS
+    std::string rawInput;
+    // timestamp of previewed frame in seconds, negative - render whole video
+    double previewTime = -1.0;
+    // length of preview clip in seconds, 0 - single frame (written as image)
+    double previewDuration = 0.0;
+    // size of preview relative to output size
+    double previewScale = 0.5;
+    // 16-bit compositing and 10-bit HEVC output, keeping samples and colorimetry of 10-bit (HDR) input
+    bool deepColor = false;
+
+    bool isPreview() const;
+};
+
+// JobRequest (de)serialization, missing fields keep their defaults
+void to_json(json& j, const JobRequest& request);
+void from_json(const json& j, JobRequest& request);
+
+// Error of job preparation, carries process exit code of command line tool
+class JobError: public std::runtime_error {
+private:
+    int _code;
+public:
+    JobError(int code, const std::string& message);
+    int code() const;
+};
+
+// Job with selected template and computed output configuration
+struct ResolvedJob {
+    JobRequest request;
+    avo::OverlayConfig overlayConfig;
+    avo::OutputConfig outputConfig;
+    // template was selected automatically
+    bool templateDetected;
+    // bits per sample of input video, samples above 8 bits are kept only with deepColor
+    int inputBitDepth = 8;
+};
+
+/**
+ * Probes input video, selects template and computes output dimensions
+ * Does not modify contents, so it can be called concurrently
+ * @param request job parameters
+ * @param contents parsed contents.json
+ * @throws JobError when input, template, padding or color is invalid
+ */
+ResolvedJob resolveJob(const JobRequest& request, const json& contents);
+
+// Properties of input, which determine template and output configuration
+struct InputInfo {
+    // dimensions in display orientation
+    int width;
+    int height;
+    double fps;
+    // clockwise rotation of decoded frames
+    int frameRotation;
+};
+
+/**
+ * Selects template and computes output dimensions for input with given properties
+ * (does not access input file)
+ * @throws JobError when template, padding or color is invalid
+ */
+ResolvedJob resolveJob(const JobRequest& request, const json& contents, const InputInfo& input);
+
+/**
+ * Renders resolved job using overlayer created from job's overlay config
+ * Selects OpenCL usage for calling thread according to job backend
+ */
+avo::RenderStats renderJob(const ResolvedJob& job, avo::Overlayer& overlayer, const avo::ProgressCallback& progress = {});
+
+// Image mode
+
+// returns true if input path is a directory, glob pattern or single PNG/JPEG image
+bool isImageInput(const std::string& inputPath);
+
+/**
+ * Lists PNG/JPEG images of image input, sorted by path
+ * @param inputPath directory, glob pattern or single image
+ */
+std::vector<std::string> listImageInputs(const std::string& inputPath);
+
+// returns overlayer for given template config, so that callers can cache them
+using OverlayerProvider = std::function<std::shared_ptr<avo::Overlayer>(const avo::OverlayConfig&)>;
+
+/**
+ * Overlays still images of image input. Images are grouped by resolution, so that template
+ * and output configuration is resolved once per group, and each group is rendered by
+ * request.segments workers. Output path is a directory of PNG images (created if missing),
+ * or output image path when input is single image.
+ * @throws JobError when there are no images, request is preview, or job can't be resolved for any of groups
+ */
+avo::RenderStats renderImageJob(
+    const JobRequest& request,
+    const json& contents,
+    const OverlayerProvider& overlayerFor,
+    const avo::ProgressCallback& progress = {}
+);
+
+// Scene mode
+
+// Scene of several device slots with computed output configuration
+struct ResolvedScene {
+    JobRequest request;
+    // slots in drawing order, each resolved as standalone job without padding
+    std::vector<ResolvedJob> slots;
+    // positions of slots in canvas
+    std::vector<cv::Point> origins;
+    avo::OutputConfig outputConfig;
+};
+
+/**
+ * Reads scene description at request input path, and resolves every slot like standalone job.
+ * Slot options missing in description are taken from request, relative input paths
+ * are relative to description file, canvas defaults to bounding box of slots.
+ * @throws JobError when description is invalid, request is preview, or any of slots can't be resolved
+ */
+ResolvedScene resolveScene(const JobRequest& request, const json& contents);
+
+// Renders resolved scene, selects OpenCL usage for calling thread according to request backend
+avo::RenderStats renderSceneJob(
+    const ResolvedScene& scene,
+    const OverlayerProvider& overlayerFor,
+    const avo::ProgressCallback& progress = {}
+);
+
+// Preview
+
+/**
+ * Renders preview of resolved job: single frame at request.previewTime written as PNG/JPEG image,
+ * or clip of request.previewDuration, at output size scaled by request.previewScale.
+ * Template assets are prepared at preview size (and cached by overlayer), audio is not copied.
+ * @throws JobError when preview parameters are invalid
+ */
+avo::RenderStats renderPreviewJob(const ResolvedJob& job, avo::Overlayer& overlayer, const avo::ProgressCallback& progress = {});
+
+#endif //SCREENFRAMER_JOB_HPP
@@ -0,0 +1,108 @@
+#ifndef SCREENFRAMER_LRUCACHE_HPP
+#define SCREENFRAMER_LRUCACHE_HPP
+
+#include <list>
+#include <mutex>
+#include <optional>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+namespace avo {
+
+/**
+ * Thread-safe least-recently-used cache, bounded by total cost of entries.
+ * Values are expected to be cheap to copy (e.g. shared pointers).
+ */
+template<class Key, class Value, class Hash = std::hash<Key>>
+class LRUCache {
+public:
+    using CostFunction = std::function<size_t(const Value&)>;
+private:
+    using Entry = std::pair<Key, Value>;
+    using Iterator = typename std::list<Entry>::iterator;
+
+    mutable std::mutex _mutex;
+    size_t _capacity;
+    size_t _cost = 0;
+    CostFunction _costOf;
+    // most recently used entries at front
+    std::list<Entry> _entries;
+    std::unordered_map<Key, Iterator, Hash> _index;
+public:
+    /**
+     * @param capacity maximum total cost of cached entries
+     * @param costOf cost of single entry, by default every entry costs 1
+     */
+    explicit LRUCache(size_t capacity, CostFunction costOf = [](const Value&) { return (size_t) 1; })
+        : _capacity(capacity), _costOf(std::move(costOf)) {}
+
+    std::optional<Value> get(const Key& key) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _index.find(key);
+        if (it == _index.end()) {
+            return std::nullopt;
+        }
+        _entries.splice(_entries.begin(), _entries, it->second);
+        return it->second->second;
+    }
+
+    void put(const Key& key, const Value& value) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _index.find(key);
+        if (it != _index.end()) {
+            _cost -= _costOf(it->second->second);
+            _entries.erase(it->second);
+            _index.erase(it);
+        }
+        _entries.emplace_front(key, value);
+        _index[key] = _entries.begin();
+        _cost += _costOf(value);
+        evict();
+    }
+
+    /**
+     * Returns cached value or creates it with factory. Factory runs without lock held,
+     * so concurrent misses of the same key may create value more than once (last one is kept).
+     */
+    template<class Factory>
+    Value getOrCreate(const Key& key, Factory&& factory) {
+        if (auto cached = get(key)) {
+            return *cached;
+        }
+        Value value = factory();
+        put(key, value);
+        return value;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries.clear();
+        _index.clear();
+        _cost = 0;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _entries.size();
+    }
+
+    size_t cost() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _cost;
+    }
+private:
+    // drops least recently used entries, always keeping the newest one
+    void evict() {
+        while (_cost > _capacity && _entries.size() > 1) {
+            Entry& last = _entries.back();
+            _cost -= _costOf(last.second);
+            _index.erase(last.first);
+            _entries.pop_back();
+        }
+    }
+};
+
+} // namespace avo
+
+#endif //SCREENFRAMER_LRUCACHE_HPP
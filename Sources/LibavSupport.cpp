@@ -0,0 +1,128 @@
+#include "LibavSupport.hpp"
+
+#ifdef SF_WITH_LIBAV
+
+#include "Debug.hpp"
+#include <stdexcept>
+#include <limits>
+
+namespace avo {
+
+void checkAV(int result, const std::string& what) {
+    if (result < 0) {
+        char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+        av_strerror(result, buffer, sizeof(buffer));
+        throw std::runtime_error(what + ": " + buffer);
+    }
+}
+
+InputContext openMediaInput(const std::string& path, AVMediaType mediaType, int& streamIndex) {
+    AVFormatContext* raw = nullptr;
+    checkAV(avformat_open_input(&raw, path.c_str(), nullptr, nullptr), "Unable to open " + path);
+    InputContext ctx(raw);
+    checkAV(avformat_find_stream_info(ctx.get(), nullptr), "Unable to read stream info of " + path);
+    streamIndex = av_find_best_stream(ctx.get(), mediaType, -1, -1, nullptr, 0);
+
+    return ctx;
+}
+
+OutputContext openMediaOutput(const std::string& path) {
+    AVFormatContext* raw = nullptr;
+    checkAV(avformat_alloc_output_context2(&raw, nullptr, nullptr, path.c_str()),
+            "Unable to create output context for " + path);
+    OutputContext ctx(raw);
+    if (!(ctx->oformat->flags & AVFMT_NOFILE)) {
+        checkAV(avio_open(&ctx->pb, path.c_str(), AVIO_FLAG_WRITE), "Unable to open " + path);
+    }
+
+    return ctx;
+}
+
+// AudioPassthrough
+
+bool AudioPassthrough::open(const std::string& sourcePath, AVFormatContext* output) {
+    _input = openMediaInput(sourcePath, AVMEDIA_TYPE_AUDIO, _audioIndex);
+    if (_audioIndex < 0) {
+        _input.reset();
+        return false;
+    }
+    // mp4 family can't carry every codec, in that case video is written without audio
+    _inStream = _input->streams[_audioIndex];
+    if (avformat_query_codec(output->oformat, _inStream->codecpar->codec_id, FF_COMPLIANCE_NORMAL) != 1) {
+        DEBUG_PRINTLN("*** Audio codec not supported by output container, skipping audio");
+        _input.reset();
+        return false;
+    }
+
+    _outStream = avformat_new_stream(output, nullptr);
+    if (_outStream == nullptr) {
+        throw std::runtime_error("Unable to create audio stream");
+    }
+    checkAV(avcodec_parameters_copy(_outStream->codecpar, _inStream->codecpar), "Unable to copy audio parameters");
+    _outStream->codecpar->codec_tag = 0;
+    _outStream->time_base = _inStream->time_base;
+
+    // only audio packets are read from source
+    for (unsigned i = 0; i < _input->nb_streams; i++) {
+        if ((int) i != _audioIndex) {
+            _input->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    int videoIndex = av_find_best_stream(_input.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (videoIndex >= 0 && _input->streams[videoIndex]->start_time != AV_NOPTS_VALUE) {
+        AVStream* videoStream = _input->streams[videoIndex];
+        _offset = av_rescale_q(videoStream->start_time, videoStream->time_base, _inStream->time_base);
+    }
+    _packet.reset(av_packet_alloc());
+    _pending = false;
+    _done = false;
+
+    return true;
+}
+
+void AudioPassthrough::writeUntil(AVFormatContext* output, int64_t timestamp, AVRational timeBase) {
+    while (!_done) {
+        if (!_pending) {
+            if (av_read_frame(_input.get(), _packet.get()) < 0) {
+                _done = true;
+                break;
+            }
+            if (_packet->stream_index != _audioIndex) {
+                av_packet_unref(_packet.get());
+                continue;
+            }
+            if (_packet->pts != AV_NOPTS_VALUE) {
+                _packet->pts -= _offset;
+            }
+            if (_packet->dts != AV_NOPTS_VALUE) {
+                _packet->dts -= _offset;
+            }
+            _pending = true;
+        }
+
+        int64_t packetTime = _packet->dts != AV_NOPTS_VALUE ? _packet->dts : _packet->pts;
+        bool unlimited = timestamp == std::numeric_limits<int64_t>::max();
+        if (!unlimited && packetTime != AV_NOPTS_VALUE
+            && av_compare_ts(packetTime, _inStream->time_base, timestamp, timeBase) > 0) {
+            break;
+        }
+
+        av_packet_rescale_ts(_packet.get(), _inStream->time_base, _outStream->time_base);
+        _packet->stream_index = _outStream->index;
+        _packet->pos = -1;
+        // takes ownership of packet data
+        checkAV(av_interleaved_write_frame(output, _packet.get()), "Unable to write audio packet");
+        _pending = false;
+    }
+}
+
+void AudioPassthrough::finish(AVFormatContext* output) {
+    writeUntil(output, std::numeric_limits<int64_t>::max(), AVRational{1, 1});
+    _input.reset();
+    _done = true;
+}
+
+} // namespace avo
+
+#endif
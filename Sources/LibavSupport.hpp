@@ -0,0 +1,105 @@
+#ifndef SCREENFRAMER_LIBAVSUPPORT_HPP
+#define SCREENFRAMER_LIBAVSUPPORT_HPP
+
+// Internal helpers shared by libav (FFmpeg) based sources, available only with SF_WITH_LIBAV
+
+#ifdef SF_WITH_LIBAV
+
+#include <memory>
+#include <string>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/mathematics.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+namespace avo {
+
+// libav resource helpers
+
+struct InputContextDeleter {
+    void operator()(AVFormatContext* ctx) const { avformat_close_input(&ctx); }
+};
+
+struct OutputContextDeleter {
+    void operator()(AVFormatContext* ctx) const {
+        if (ctx->pb != nullptr && !(ctx->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&ctx->pb);
+        }
+        avformat_free_context(ctx);
+    }
+};
+
+struct PacketDeleter {
+    void operator()(AVPacket* pkt) const { av_packet_free(&pkt); }
+};
+
+struct CodecContextDeleter {
+    void operator()(AVCodecContext* ctx) const { avcodec_free_context(&ctx); }
+};
+
+struct FrameDeleter {
+    void operator()(AVFrame* frame) const { av_frame_free(&frame); }
+};
+
+struct ScalerDeleter {
+    void operator()(SwsContext* ctx) const { sws_freeContext(ctx); }
+};
+
+using InputContext = std::unique_ptr<AVFormatContext, InputContextDeleter>;
+using OutputContext = std::unique_ptr<AVFormatContext, OutputContextDeleter>;
+using Packet = std::unique_ptr<AVPacket, PacketDeleter>;
+using CodecContext = std::unique_ptr<AVCodecContext, CodecContextDeleter>;
+using Frame = std::unique_ptr<AVFrame, FrameDeleter>;
+using Scaler = std::unique_ptr<SwsContext, ScalerDeleter>;
+
+// throws std::runtime_error with libav error description if result is negative
+void checkAV(int result, const std::string& what);
+
+/**
+ * Opens media file and reads its stream info
+ * @param mediaType type of stream to find
+ * @param streamIndex index of the best stream of given type, or negative error code if there's none
+ */
+InputContext openMediaInput(const std::string& path, AVMediaType mediaType, int& streamIndex);
+
+// Creates output context (format guessed from path) and opens its file
+OutputContext openMediaOutput(const std::string& path);
+
+/**
+ * Copies audio packets of source file into output, without decoding.
+ * Audio is aligned to the start of source video stream, so that it stays in sync
+ * with video frames written from the beginning of the source.
+ * Usage: open (before output header), then writeUntil before every video packet, finish at the end.
+ */
+class AudioPassthrough {
+private:
+    InputContext _input;
+    int _audioIndex = -1;
+    AVStream* _inStream = nullptr;
+    AVStream* _outStream = nullptr;
+    Packet _packet;
+    bool _pending = false;
+    bool _done = true;
+    // start of source video, in audio time base
+    int64_t _offset = 0;
+public:
+    /**
+     * Adds audio stream of source to output, does nothing if source has no audio
+     * @return true if audio stream was added
+     */
+    bool open(const std::string& sourcePath, AVFormatContext* output);
+    // writes audio packets with timestamps not later than given timestamp (INT64_MAX - no limit)
+    void writeUntil(AVFormatContext* output, int64_t timestamp, AVRational timeBase);
+    // writes remaining audio packets
+    void finish(AVFormatContext* output);
+};
+
+} // namespace avo
+
+#endif
+
+#endif //SCREENFRAMER_LIBAVSUPPORT_HPP
@@ -0,0 +1,216 @@
+#include "OutputCache.hpp"
+#include "Debug.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+
+#ifndef VERSION_NUMBER
+#error "VERSION NUMBER must be defined before compilation"
+#endif
+
+namespace fs = std::filesystem;
+
+// Hashing
+
+static constexpr uint64_t HASH_PRIME_1 = 0x9e3779b97f4a7c15ull;
+static constexpr uint64_t HASH_PRIME_2 = 0xbf58476d1ce4e5b9ull;
+// multiple of lane block, so that only last chunk has a tail
+static constexpr size_t HASH_CHUNK_SIZE = 1 << 20;
+
+static inline uint64_t hashMix(uint64_t h, uint64_t word) {
+    h ^= word * HASH_PRIME_2;
+    h = (h << 31u) | (h >> 33u);
+    return h * HASH_PRIME_1;
+}
+
+// splitmix64 finalizer
+static inline uint64_t hashFinalize(uint64_t h) {
+    h ^= h >> 30u;
+    h *= HASH_PRIME_2;
+    h ^= h >> 27u;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31u;
+    return h;
+}
+
+// four independent lanes, so that multiplications of consecutive words overlap
+struct HashState {
+    uint64_t lanes[4] = {HASH_PRIME_1, HASH_PRIME_2, ~HASH_PRIME_1, ~HASH_PRIME_2};
+    uint64_t length = 0;
+
+    void update(const char* data, size_t size) {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            uint64_t words[4];
+            std::memcpy(words, data + i, sizeof(words));
+            for (int lane = 0; lane < 4; lane++) {
+                lanes[lane] = hashMix(lanes[lane], words[lane]);
+            }
+        }
+        for (; i < size; i += 8) {
+            uint64_t word = 0;
+            std::memcpy(&word, data + i, std::min<size_t>(8, size - i));
+            lanes[0] = hashMix(lanes[0], word);
+        }
+        length += size;
+    }
+
+    uint64_t digest() const {
+        uint64_t h = hashMix(length, lanes[0]);
+        for (int lane = 1; lane < 4; lane++) {
+            h = hashMix(h, lanes[lane]);
+        }
+        return hashFinalize(h);
+    }
+};
+
+uint64_t hashFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Unable to read " + path);
+    }
+    std::vector<char> buffer(HASH_CHUNK_SIZE);
+    HashState state;
+    while (file) {
+        file.read(buffer.data(), (std::streamsize) buffer.size());
+        state.update(buffer.data(), (size_t) file.gcount());
+    }
+
+    return state.digest();
+}
+
+static uint64_t hashString(const std::string& str) {
+    HashState state;
+    state.update(str.data(), str.size());
+    return state.digest();
+}
+
+static std::string lowercaseExtension(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext;
+}
+
+// OutputCache
+
+OutputCache::OutputCache(std::string directory, uintmax_t limitBytes)
+    : _directory(std::move(directory)), _limitBytes(limitBytes) {}
+
+std::string OutputCache::key(const ResolvedJob& job) {
+    // everything, which affects rendered output (output path only through its format)
+    const avo::OverlayConfig& overlay = job.overlayConfig;
+    const avo::OutputConfig& output = job.outputConfig;
+    std::ostringstream config;
+    config << std::setprecision(17)
+           << VERSION_NUMBER << '|' << overlay.imagePath << '|' << overlay.screenLeft << ',' << overlay.screenTop
+           << ',' << overlay.screenRight << ',' << overlay.screenBottom << ',' << overlay.templateWidth
+           << ',' << overlay.templateHeight << '|' << lowercaseExtension(output.path) << '|' << output.fps
+           << ',' << output.width << ',' << output.height << ',' << output.paddingHorizontal
+           << ',' << output.paddingVertical << '|' << (int) output.backgroundColor.red
+           << ',' << (int) output.backgroundColor.green << ',' << (int) output.backgroundColor.blue
+           << '|' << output.compactMemory << ',' << (int) output.scaleFilter << ',' << output.scaleAtDecode
+           << ',' << output.templateRotation << ',' << output.frameRotation << ',' << !output.audioSourcePath.empty()
+           << ',' << output.crf
+           << '|' << output.background.imagePath << ',' << (int) output.background.gradient
+           << ',' << (int) output.background.gradientColor.red << ',' << (int) output.background.gradientColor.green
+           << ',' << (int) output.background.gradientColor.blue << ',' << output.background.gradientAngle
+           << ',' << output.background.shadowBlur << ',' << output.background.shadowOffsetX
+           << ',' << output.background.shadowOffsetY << ',' << output.background.shadowOpacity
+           << '|' << output.rawInputFormat.width << ',' << output.rawInputFormat.height
+           << ',' << output.rawInputFormat.fps << ',' << (int) output.rawInputFormat.pixelFormat
+           << '|' << output.deepColor << ',' << output.colorInfo.primaries << ',' << output.colorInfo.transfer
+           << ',' << output.colorInfo.matrix << ',' << output.colorInfo.fullRange
+           << '|' << job.request.backend;
+
+    // template and background images are part of output, like input (they may be replaced at the same path)
+    config << '|' << hashFile(overlay.imagePath);
+    if (!output.background.imagePath.empty()) {
+        config << '|' << hashFile(output.background.imagePath);
+    }
+
+    std::ostringstream key;
+    key << std::hex << std::setfill('0')
+        << std::setw(16) << hashFile(job.request.inputPath)
+        << std::setw(16) << hashString(config.str());
+    return key.str();
+}
+
+std::string OutputCache::entryPath(const std::string& key, const std::string& outputPath) const {
+    return (fs::path(_directory) / (key + lowercaseExtension(outputPath))).string();
+}
+
+bool OutputCache::restore(const std::string& key, const std::string& outputPath) const {
+    std::error_code error;
+    fs::path entry = entryPath(key, outputPath);
+    if (!fs::is_regular_file(entry, error)) {
+        return false;
+    }
+
+    // entry is copied, not linked, so that in-place edits of output (e.g. tagging) do not modify it
+    fs::copy_file(entry, outputPath, fs::copy_options::overwrite_existing, error);
+    if (error) {
+        DEBUG_PRINTLN("*** Unable to restore cached output: " << error.message());
+        return false;
+    }
+    // modification time orders entries for eviction
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), error);
+
+    return true;
+}
+
+void OutputCache::store(const std::string& key, const std::string& outputPath) const {
+    std::error_code error;
+    fs::create_directories(_directory, error);
+    // entry is copied (output may be modified later) and renamed, so that other processes never see partial entry
+    fs::path entry = entryPath(key, outputPath);
+    std::ostringstream tempName;
+    tempName << '.' << key << '.' << getpid() << '.' << std::hash<std::thread::id>()(std::this_thread::get_id());
+    fs::path temp = fs::path(_directory) / tempName.str();
+    if (!fs::copy_file(outputPath, temp, fs::copy_options::overwrite_existing, error)) {
+        DEBUG_PRINTLN("*** Unable to store output in cache: " << error.message());
+        fs::remove(temp, error);
+        return;
+    }
+    fs::rename(temp, entry, error);
+    if (error) {
+        DEBUG_PRINTLN("*** Unable to store output in cache: " << error.message());
+        fs::remove(temp, error);
+        return;
+    }
+
+    evict();
+}
+
+void OutputCache::evict() const {
+    std::error_code error;
+    std::vector<std::tuple<fs::file_time_type, uintmax_t, fs::path>> entries;
+    for (const auto& item : fs::directory_iterator(_directory, error)) {
+        // hidden files are entries being stored
+        if (item.is_regular_file(error) && item.path().filename().string()[0] != '.') {
+            entries.emplace_back(item.last_write_time(error), item.file_size(error), item.path());
+        }
+    }
+    // most recently used first
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        return std::get<0>(a) > std::get<0>(b);
+    });
+
+    uintmax_t totalBytes = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        totalBytes += std::get<1>(entries[i]);
+        if (i > 0 && totalBytes > _limitBytes) {
+            DEBUG_PRINTLN("*** Evicting cached output " << std::get<2>(entries[i]));
+            fs::remove(std::get<2>(entries[i]), error);
+            totalBytes -= std::get<1>(entries[i]);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef SCREENFRAMER_OUTPUTCACHE_HPP
+#define SCREENFRAMER_OUTPUTCACHE_HPP
+
+#include <string>
+#include <cstdint>
+#include "Job.hpp"
+
+/**
+ * On-disk cache of rendered outputs, addressed by hash of input contents and resolved job configuration.
+ * Entries are stored and restored as copies, least recently used entries
+ * are evicted when total size exceeds limit. Safe to share between processes.
+ */
+class OutputCache {
+private:
+    std::string _directory;
+    uintmax_t _limitBytes;
+public:
+    /**
+     * @param directory cache directory, created if missing
+     * @param limitBytes limit of total size of entries (most recent entry is kept even if it exceeds it)
+     */
+    OutputCache(std::string directory, uintmax_t limitBytes);
+
+    // key of job: hash of input and template contents, output configuration and program version
+    static std::string key(const ResolvedJob& job);
+    /**
+     * Restores cached output of given key at output path
+     * @return false if there is no such entry
+     */
+    bool restore(const std::string& key, const std::string& outputPath) const;
+    // stores rendered output under given key and evicts entries above size limit
+    void store(const std::string& key, const std::string& outputPath) const;
+private:
+    std::string entryPath(const std::string& key, const std::string& outputPath) const;
+    void evict() const;
+};
+
+// fast non-cryptographic 64-bit hash of file contents
+uint64_t hashFile(const std::string& path);
+
+#endif //SCREENFRAMER_OUTPUTCACHE_HPP
@@ -6,6 +6,7 @@
 #include <iomanip>
 #include <sstream>
 #include <cstdio>
+#include <stdexcept>
 
 namespace avo {
 
@@ -43,6 +44,93 @@ std::string RGBColor::hexString() {
     return ss.str();
 }
 
+// ScaleFilter
+
+ScaleFilter parseScaleFilter(const std::string& name) {
+    if (name == "area") {
+        return ScaleFilter::Area;
+    } else if (name == "bilinear") {
+        return ScaleFilter::Bilinear;
+    } else if (name == "lanczos") {
+        return ScaleFilter::Lanczos;
+    }
+
+    throw std::invalid_argument("Unknown scale filter \"" + name + "\"");
+}
+
+// Background
+
+bool Background::hasShadow() const {
+    return shadowOpacity > 0.0;
+}
+
+bool Background::isFlat() const {
+    return imagePath.empty() && gradient == GradientType::None && !hasShadow();
+}
+
+void parseGradient(const std::string& spec, Background& background) {
+    std::stringstream stream(spec);
+    std::string type, color, angle;
+    std::getline(stream, type, ':');
+    std::getline(stream, color, ':');
+    std::getline(stream, angle);
+    if (type == "linear") {
+        background.gradient = GradientType::Linear;
+    } else if (type == "radial" && angle.empty()) {
+        background.gradient = GradientType::Radial;
+    } else {
+        throw std::invalid_argument("Invalid gradient \"" + spec + "\", expected linear:#RRGGBB[:ANGLE] or radial:#RRGGBB");
+    }
+    background.gradientColor = RGBColor(color);
+    if (!angle.empty()) {
+        size_t length = 0;
+        background.gradientAngle = std::stod(angle, &length);
+        if (length != angle.size()) {
+            throw std::invalid_argument("Invalid gradient angle \"" + angle + "\"");
+        }
+    }
+}
+
+void parseShadow(const std::string& spec, Background& background) {
+    double values[4] = {0.0, 0.0, 0.0, 0.5};
+    int count = 0;
+    std::stringstream stream(spec);
+    std::string value;
+    while (std::getline(stream, value, ':')) {
+        size_t length = 0;
+        if (count == 4 || value.empty() || (values[count] = std::stod(value, &length), length != value.size())) {
+            count = 0;
+            break;
+        }
+        count++;
+    }
+    if (count == 0 || count == 2 || values[0] < 0.0 || values[3] < 0.0 || values[3] > 1.0) {
+        throw std::invalid_argument("Invalid shadow \"" + spec + "\", expected BLUR[:OFFSETX:OFFSETY[:OPACITY]]");
+    }
+    background.shadowBlur = values[0];
+    background.shadowOffsetX = values[1];
+    background.shadowOffsetY = values[2];
+    background.shadowOpacity = values[3];
+}
+
+// ColorInfo
+
+bool ColorInfo::isHdr() const {
+    return transfer == PQ_TRANSFER || transfer == HLG_TRANSFER;
+}
+
+// RawVideoFormat
+
+bool RawVideoFormat::isValid() const {
+    bool evenSize = width % 2 == 0 && height % 2 == 0;
+    return width > 0 && height > 0 && fps > 0.0 && (pixelFormat != RawPixelFormat::I420 || evenSize);
+}
+
+size_t RawVideoFormat::frameBytes() const {
+    size_t pixels = (size_t) width * height;
+    return pixelFormat == RawPixelFormat::I420 ? pixels * 3 / 2 : pixels * 3;
+}
+
 // OutputConfig
 
 OutputConfig::OutputConfig(
@@ -57,7 +145,16 @@ OutputConfig::OutputConfig(
    paddingHorizontal(pH), paddingVertical(pV), backgroundColor(backgroundColor) {}
 
 bool OutputConfig::isValid() const {
-    return width > 0 && height > 0 && fps > 0.0;
+    return width > 0 && height > 0 && fps > 0.0
+        && normalizeRotation(templateRotation) >= 0 && normalizeRotation(frameRotation) >= 0;
+}
+
+int normalizeRotation(int degrees) {
+    if (degrees % 90 != 0) {
+        return -1;
+    }
+
+    return ((degrees % 360) + 360) % 360;
 }
 
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #include <string>
 #include <cstdint>
+#include <cstddef>
 
 namespace avo {
 
@@ -21,6 +22,103 @@ struct RGBColor {
     std::string hexString();
 };
 
+// Resampling filter used when video-frames do not fit screen at identity or integer ratio
+enum class ScaleFilter {
+    Area,
+    Bilinear,
+    Lanczos
+};
+
+// parses filter name (area, bilinear, lanczos)
+ScaleFilter parseScaleFilter(const std::string& name);
+
+// Shape of background gradient
+enum class GradientType {
+    None,
+    Linear,
+    Radial
+};
+
+/**
+ * Layers drawn below device frame, instead of flat background color.
+ * They are rendered once, when task is initialized, so they do not add per-frame work.
+ */
+struct Background {
+    // image covering whole output (scaled to fill, cropped at center), empty - none
+    std::string imagePath;
+    // gradient from background color to gradientColor (not drawn with image)
+    GradientType gradient = GradientType::None;
+    RGBColor gradientColor;
+    // direction of linear gradient, clockwise in degrees (0 - left to right, 90 - top to bottom)
+    double gradientAngle = 90.0;
+    // drop shadow of device, blur (standard deviation) and offset are fractions of device frame height
+    double shadowBlur = 0.0;
+    double shadowOffsetX = 0.0;
+    double shadowOffsetY = 0.0;
+    // darkness of shadow [0.0, 1.0], 0 - no shadow
+    double shadowOpacity = 0.0;
+
+    bool hasShadow() const;
+    // background is flat color (no image, gradient nor shadow)
+    bool isFlat() const;
+};
+
+/**
+ * Parses gradient given as TYPE:#RRGGBB[:ANGLE] (type: linear, radial), the color is end color
+ * @throws std::invalid_argument if spec is invalid
+ */
+void parseGradient(const std::string& spec, Background& background);
+
+/**
+ * Parses drop shadow given as BLUR[:OFFSETX:OFFSETY[:OPACITY]] (fractions of device frame height)
+ * @throws std::invalid_argument if spec is invalid
+ */
+void parseShadow(const std::string& spec, Background& background);
+
+/**
+ * Colorimetry of video stream, carried from input to output, so that HDR (PQ, HLG) signal is passed through.
+ * Values are H.273 code points (same as libav AVColorPrimaries, AVColorTransferCharacteristic, AVColorSpace),
+ * 2 - unspecified.
+ */
+struct ColorInfo {
+    int primaries = 2;
+    int transfer = 2;
+    int matrix = 2;
+    // samples use full range (0 - 2^bits - 1), instead of limited (video) range
+    bool fullRange = false;
+
+    // H.273 code points used by HDR video
+    static constexpr int BT2020_PRIMARIES = 9;
+    static constexpr int PQ_TRANSFER = 16;
+    static constexpr int HLG_TRANSFER = 18;
+
+    // transfer is PQ (SMPTE ST 2084) or HLG (ARIB STD-B67)
+    bool isHdr() const;
+};
+
+// Pixel layout of uncompressed video frames
+enum class RawPixelFormat {
+    // packed 8-bit bgr
+    BGR24,
+    // planar 8-bit YUV 4:2:0 (Y plane, followed by quarter size U and V planes)
+    I420
+};
+
+// Geometry of headerless raw video, which can't be probed from file
+struct RawVideoFormat {
+    int width = 0;
+    int height = 0;
+    double fps = 0.0;
+    RawPixelFormat pixelFormat = RawPixelFormat::BGR24;
+
+    bool isValid() const;
+    // number of bytes of single frame
+    size_t frameBytes() const;
+};
+
+// constant rate factor of libav video encoders (default of libx264)
+constexpr int DEFAULT_CRF = 23;
+
 struct OutputConfig {
     std::string path;
     double fps;
@@ -29,12 +127,37 @@ struct OutputConfig {
     double paddingHorizontal;
     double paddingVertical;
     RGBColor backgroundColor;
+    // image, gradient and shadow drawn over background color
+    Background background;
+    // keep only 8-bit task buffers, and blend screen area in place
+    bool compactMemory = false;
+    ScaleFilter scaleFilter = ScaleFilter::Bilinear;
+    // let decoder downscale large inputs to screen size, before conversion to BGR (when supported)
+    bool scaleAtDecode = false;
+    // clockwise rotation of device template in degrees (0, 90, 180, 270), 90 and 270 give landscape device
+    int templateRotation = 0;
+    // clockwise rotation of decoded frames in degrees (from video metadata), done together with resize,
+    // so decoder's own rotation is disabled when it's nonzero
+    int frameRotation = 0;
+    // file, whose audio is copied into output video without re-encoding, empty - no audio
+    std::string audioSourcePath;
+    // geometry of input, when it's headerless raw video (.yuv, .bgr)
+    RawVideoFormat rawInputFormat;
+    // 16 bits per channel from decoder to 10-bit HEVC encoder (requires compactMemory, blending is in place)
+    bool deepColor = false;
+    // colorimetry of input, written into 10-bit output
+    ColorInfo colorInfo;
+    // quality of libav encoded video (0 - 51, lower is better), cv::VideoWriter uses its own settings
+    int crf = DEFAULT_CRF;
 
     OutputConfig(std::string path, double fps, int width, int height, double pH, double pV, RGBColor backgroundColor = {});
     ~OutputConfig() = default;
     bool isValid() const;
 };
 
+// normalizes rotation to [0, 360) range, returns -1 if it's not multiple of 90 degrees
+int normalizeRotation(int degrees);
+
 } // namespace avo
 
 #endif //SCREENFRAMER_OUTPUTCONFIG_HPP_
@@ -4,29 +4,146 @@
 
 #include "OverlayTask.hpp"
 #include "Overlayer.hpp"
+#include "FramePool.hpp"
+#include "Profiler.hpp"
+#include "Placement.hpp"
+#include "Background.hpp"
+#include "DeepVideo.hpp"
 #include "Debug.hpp"
 #include <opencv2/imgproc.hpp>
-
-#ifdef MACOS_APP
-#define API_PREFERENCE cv::CAP_AVFOUNDATION
-#else
-#define API_PREFERENCE cv::CAP_ANY
-#endif
+#include <type_traits>
 
 namespace avo {
 
+cv::Size templateFrameSize(const OutputConfig& outputConfig) {
+    double frameWidth = (double) outputConfig.width / (1.0 + 2 * outputConfig.paddingHorizontal);
+    double frameHeight = (double) outputConfig.height / (1.0 + 2 * outputConfig.paddingVertical);
+    return {(int) frameWidth, (int) frameHeight};
+}
+
+// TemplateAssets
+
+template<class MatType>
+std::shared_ptr<const TemplateAssets<MatType>> TemplateAssets<MatType>::prepare(
+    const cv::Mat& device,
+    const cv::Mat& mask,
+    cv::Size frameSize,
+    int rotation,
+    bool compactMemory,
+    bool deepColor,
+    const ColorInfo& colorInfo
+) {
+    if (device.empty() || mask.empty() || mask.channels() != 1) {
+        throw std::invalid_argument("DeviceFrame/Mask are invalid (are empty or have invalid channel count");
+    }
+
+    rotation = normalizeRotation(rotation);
+    if (rotation < 0) {
+        throw std::invalid_argument("Template rotation must be multiple of 90 degrees");
+    }
+
+    auto assets = std::make_shared<TemplateAssets<MatType>>();
+
+    // resize (rotated) device frame and mask to desired size
+    // (temporaries and persistent buffers are recycled through frame pool)
+    cv::Mat tempMask;
+    cv::Mat tempDevice;
+    usePool(tempMask);
+    usePool(tempDevice);
+    usePool(assets->device);
+    usePool(assets->mask);
+    if (rotation != 0) {
+        cv::Mat rotatedDevice;
+        cv::Mat rotatedMask;
+        int rotateCode = rotation == 90 ? cv::ROTATE_90_CLOCKWISE
+            : (rotation == 180 ? cv::ROTATE_180 : cv::ROTATE_90_COUNTERCLOCKWISE);
+        cv::rotate(device, rotatedDevice, rotateCode);
+        cv::rotate(mask, rotatedMask, rotateCode);
+        assets->templateSize = rotatedDevice.size();
+        cv::resize(rotatedDevice, tempDevice, frameSize);
+        cv::resize(rotatedMask, tempMask, frameSize);
+    } else {
+        assets->templateSize = device.size();
+        cv::resize(device, tempDevice, frameSize);
+        cv::resize(mask, tempMask, frameSize);
+    }
+
+    if (compactMemory && deepColor) {
+        // device in video signal * mask -> device (16-bit), single channel 65535 - mask -> mask
+        cv::Mat tempMask3;
+        cv::Mat tempMask16;
+        cv::Mat tempDevice16;
+        usePool(tempMask3);
+        usePool(tempMask16);
+        usePool(tempDevice16);
+        sdrToSignal(tempDevice, tempDevice16, colorInfo);
+        tempMask.convertTo(tempMask16, CV_16U, 257.0);
+        cv::cvtColor(tempMask16, tempMask3, cv::COLOR_GRAY2BGR);
+        cv::multiply(tempDevice16, tempMask3, assets->device, 1.0 / 65535.0);
+        cv::subtract(cv::Scalar(65535), tempMask16, assets->mask);
+        return assets;
+    }
+    if (compactMemory) {
+        // device * mask -> device (8-bit), single channel 255 - mask -> mask
+        cv::Mat tempMask3;
+        usePool(tempMask3);
+        cv::cvtColor(tempMask, tempMask3, cv::COLOR_GRAY2BGR);
+        cv::multiply(tempDevice, tempMask3, assets->device, 1.0 / 255.0);
+        cv::subtract(cv::Scalar(255), tempMask, assets->mask);
+        return assets;
+    }
+
+    // mask -> 3 float channels [0.0, 1.0]
+    tempMask.convertTo(tempMask, CV_32F);
+    tempMask /= 255.0;
+    cv::cvtColor(tempMask, tempMask, cv::COLOR_GRAY2BGR);
+
+    // device -> float
+    tempDevice.convertTo(tempDevice, CV_32F);
+
+    // device * mask -> device
+    cv::multiply(tempDevice, tempMask, assets->device);
+
+    // invert mask
+    cv::subtract(1.0, tempMask, tempMask);
+    tempMask.copyTo(assets->mask);
+
+    return assets;
+}
+
+template<class MatType>
+size_t TemplateAssets<MatType>::allocatedBytes() const {
+    return device.total() * device.elemSize() + mask.total() * mask.elemSize();
+}
+
+// Task
+
 template<class MatType>
 Task<MatType>::Task(
     const cv::Mat &device,
     const cv::Mat &mask,
     const OverlayConfig &overlayConfig,
     const OutputConfig &outputConfig
-): _outputConfig(outputConfig) {
-    if (device.empty() || mask.empty() || mask.channels() != 1) {
-        throw std::invalid_argument("DeviceFrame/Mask are invalid (are empty or have invalid channel count");
+): Task(
+    TemplateAssets<MatType>::prepare(
+        device, mask, templateFrameSize(outputConfig), outputConfig.templateRotation,
+        outputConfig.compactMemory, outputConfig.deepColor, outputConfig.colorInfo
+    ),
+    overlayConfig,
+    outputConfig
+) {}
+
+template<class MatType>
+Task<MatType>::Task(
+    std::shared_ptr<const TemplateAssets<MatType>> assets,
+    const OverlayConfig &unrotatedConfig,
+    const OutputConfig &outputConfig
+): _outputConfig(outputConfig), _assets(std::move(assets)) {
+    if (_assets == nullptr) {
+        throw std::invalid_argument("TemplateAssets are missing");
     }
 
-    if (!overlayConfig.isValid()) {
+    if (!unrotatedConfig.isValid()) {
         throw std::invalid_argument("OverlayConfig is not valid");
     }
 
@@ -34,11 +151,23 @@ Task<MatType>::Task(
         throw std::invalid_argument("OutputConfig is not valid!");
     }
 
+    if (outputConfig.compactMemory && !std::is_same_v<MatType, cv::Mat>) {
+        throw std::invalid_argument("Compact memory mode is supported only for cv::Mat tasks");
+    }
+
+    if (outputConfig.deepColor && !outputConfig.compactMemory) {
+        throw std::invalid_argument("Deep color mode requires compact memory mode");
+    }
+
+    // screen bounds of template in output orientation
+    OverlayConfig overlayConfig = unrotatedConfig.rotated(outputConfig.templateRotation);
+    _frameRotation = normalizeRotation(outputConfig.frameRotation);
+
     // translate offsets/dimensions according to config
     double frameWidth = (double) outputConfig.width / (1.0 + 2 * outputConfig.paddingHorizontal);
     double frameHeight = (double) outputConfig.height / (1.0 + 2 * outputConfig.paddingVertical);
-    double fx = frameWidth / (double) device.cols;
-    double fy = frameHeight / (double) device.rows;
+    double fx = frameWidth / (double) _assets->templateSize.width;
+    double fy = frameHeight / (double) _assets->templateSize.height;
     int translatedOriginX = (int) round(overlayConfig.screenLeft * fx);
     int translatedOriginY = (int) round(overlayConfig.screenTop * fy);
     int translatedEndingX = (int) round(overlayConfig.screenRight * fx);
@@ -65,97 +194,420 @@ Task<MatType>::Task(
     DEBUG_PRINTLN("*** Translated frame ox - " << _frameOriginX << ", oy - " << _frameOriginY);
     DEBUG_PRINTLN("*** Translated screen ox - " << _screenOriginX << ", oy - " << _screenOriginY);
 
-    // resize device frame and mask to desired size
-    cv::Mat tempMask;
-    cv::Mat tempDevice;
-    cv::resize(device, tempDevice, {_frameWidth, _frameHeight});
-    cv::resize(mask, tempMask, {_frameWidth, _frameHeight});
-
-    // mask -> 3 float channels [0.0, 1.0]
-    tempMask.convertTo(tempMask, CV_32F);
-    tempMask /= 255.0;
-    cv::cvtColor(tempMask, tempMask, cv::COLOR_GRAY2BGR);
-
-    // device -> float
-    tempDevice.convertTo(tempDevice, CV_32F);
-
-    // device * mask -> _device
-    cv::multiply(tempDevice, tempMask, _device);
-
-    // invert mask
-    cv::subtract(1.0, tempMask, tempMask);
-    tempMask.copyTo(_mask);
+    if (_assets->device.size() != cv::Size(_frameWidth, _frameHeight)
+        || _assets->device.depth() != (outputConfig.deepColor ? CV_16U : (outputConfig.compactMemory ? CV_8U : CV_32F))) {
+        throw std::invalid_argument("TemplateAssets do not match OutputConfig");
+    }
 }
 
 template<class MatType>
 void Task<MatType>::initialize() {
+    if (_outputConfig.deepColor) {
+        // only libav writer accepts 16-bit frames
+        initialize(std::make_unique<LibavFrameWriter>(_outputConfig.audioSourcePath, _outputConfig.crf, true, _outputConfig.colorInfo));
+    } else {
+        initialize(FrameWriter::create(_outputConfig.path, _outputConfig.audioSourcePath, _outputConfig.crf));
+    }
+}
+
+template<class MatType>
+void Task<MatType>::initialize(std::unique_ptr<FrameWriter> writer) {
     if (isActive()) {
         throw std::runtime_error("Task is already active");
     }
 
     // allocate memory and prepare output frame
     int outputWidth = _outputConfig.width, outputHeight = _outputConfig.height;
-    _screenFrame.create(outputHeight, outputWidth, CV_32FC3);
-    _screenFrame.setTo(_backgroundColor);
+    usePool(_screenFrame);
+    usePool(_outputFloatFrame);
+    usePool(_outputFrame);
+    usePool(_u8Frame);
+    usePool(_hostOutputFrame);
     // screen bounds + 1-pix border
     cv::Rect roi(_screenOriginX - 1, _screenOriginY - 1, _screenWidth + 2, _screenHeight + 2);
-    _screenFrame(roi).setTo(cv::Scalar(0.0, 0.0, 0.0));
-    // mats for storing output
-    _outputFloatFrame.create(outputHeight, outputWidth, CV_32FC3);
-    _outputFloatFrame.setTo(_backgroundColor);
-    _outputFrame.create(outputHeight, outputWidth, CV_8UC3);
+    // background layers are rendered once into buffers, which are never overwritten outside device frame
+    cv::Mat background = renderBackgroundLayers();
+    if (_outputConfig.compactMemory) {
+        // everything outside screen bounds is static, so it's blended only once here
+        // (colors are converted to 16-bit video signal in deep color mode)
+        bool deep = _outputConfig.deepColor;
+        _outputFrame.create(outputHeight, outputWidth, deep ? CV_16UC3 : CV_8UC3);
+        if (background.empty() && deep) {
+            cv::Mat color(1, 1, CV_32FC3, _backgroundColor), signal;
+            sdrToSignal(color, signal, _outputConfig.colorInfo);
+            cv::Vec3w sample = signal.at<cv::Vec3w>(0, 0);
+            _outputFrame.setTo(cv::Scalar(sample[0], sample[1], sample[2]));
+        } else if (background.empty()) {
+            _outputFrame.setTo(_backgroundColor);
+        } else if (deep) {
+            cv::Mat signal;
+            sdrToSignal(background, signal, _outputConfig.colorInfo);
+            signal.copyTo(_outputFrame);
+        } else {
+            background.convertTo(_outputFrame, CV_8U);
+        }
+        _outputFrame(roi).setTo(cv::Scalar(0, 0, 0));
+        if constexpr (std::is_same_v<MatType, cv::Mat>) {
+            cv::Rect frameRect(_frameOriginX, _frameOriginY, _frameWidth, _frameHeight);
+            // screen area is mostly transparent in template, per frame only its edges are blended
+            cv::Rect screenInFrameRect = screenRect() - cv::Point(_frameOriginX, _frameOriginY);
+            if (deep) {
+                Compositor<PixelFormat::BGR48, BlendPolicy::PremultipliedOver>(_assets->mask)
+                    .apply(_outputFrame(frameRect), _assets->device);
+                _deepScreenCompositor = Compositor<PixelFormat::BGR48, BlendPolicy::EdgeOnly>(_assets->mask(screenInFrameRect));
+            } else {
+                Compositor<PixelFormat::BGR24, BlendPolicy::PremultipliedOver>(_assets->mask)
+                    .apply(_outputFrame(frameRect), _assets->device);
+                _screenCompositor = Compositor<PixelFormat::BGR24, BlendPolicy::EdgeOnly>(_assets->mask(screenInFrameRect));
+            }
+        }
+    } else {
+        _outputFloatFrame.create(outputHeight, outputWidth, CV_32FC3);
+        if (background.empty()) {
+            _outputFloatFrame.setTo(_backgroundColor);
+        } else {
+            background.copyTo(_outputFloatFrame);
+        }
+        if constexpr (std::is_same_v<MatType, cv::Mat>) {
+            // screen is embedded straight into output frame, static area is blended only once here,
+            // per frame only screen edges (with the same float operations as cv::multiply and cv::add)
+            _outputFloatFrame(roi).setTo(cv::Scalar(0.0, 0.0, 0.0));
+            cv::Mat inverseAlpha;
+            cv::extractChannel(_assets->mask, inverseAlpha, 0);
+            cv::Rect frameRect(_frameOriginX, _frameOriginY, _frameWidth, _frameHeight);
+            cv::Rect screenInFrameRect = screenRect() - cv::Point(_frameOriginX, _frameOriginY);
+            Compositor<PixelFormat::BGR96F, BlendPolicy::PremultipliedOver>(inverseAlpha)
+                .apply(_outputFloatFrame(frameRect), _assets->device);
+            _floatScreenCompositor = Compositor<PixelFormat::BGR96F, BlendPolicy::EdgeOnly>(inverseAlpha(screenInFrameRect));
+        } else {
+            // device (cv::UMat) tasks blend whole device frame with opencl kernels
+            _screenFrame.create(outputHeight, outputWidth, CV_32FC3);
+            _outputFloatFrame.copyTo(_screenFrame);
+            _screenFrame(roi).setTo(cv::Scalar(0.0, 0.0, 0.0));
+        }
+        // mats for storing output
+        _outputFrame.create(outputHeight, outputWidth, CV_8UC3);
 
-    // allocate memory for floating point frame and uint8 frame (resized frame)
-    _u8Frame.create(_screenHeight, _screenWidth, CV_32FC3);
+        // allocate memory for uint8 frame (resized frame)
+        _u8Frame.create(_screenHeight, _screenWidth, CV_8UC3);
+    }
 
     // setup and open output video
-    int fourcc = cv::VideoWriter::fourcc('a', 'v', 'c', '1');
     cv::Size size = {outputWidth, outputHeight};
-    bool res = _outputWriter.open(_outputConfig.path, API_PREFERENCE, fourcc, _outputConfig.fps, size);
+    _outputWriter = std::move(writer);
+    bool res;
+    {
+        // encoder threads are started while opening
+        ScopedPlacement placement(Stage::Encode);
+        res = _outputWriter->open(_outputConfig.path, _outputConfig.fps, size);
+    }
     DEBUG_PRINT("*** OPEN result: " << res);
     if (res) {
-        DEBUG_PRINTLN(", backend: " << _outputWriter.getBackendName());
+        DEBUG_PRINTLN(", backend: " << _outputWriter->backendName());
     } else {
         DEBUG_PRINT("\n");
     }
+
+    if (res && _outputWriter->usesStaticFrame()) {
+        prepareStaticFrame();
+    }
+}
+
+template<class MatType>
+void Task<MatType>::setBackground(const cv::Mat& background) {
+    if (background.type() != CV_32FC3 || background.size() != cv::Size(_outputConfig.width, _outputConfig.height)) {
+        throw std::invalid_argument("Background must be CV_32FC3 image of output size");
+    }
+    _backgroundImage = background;
+}
+
+template<class MatType>
+cv::Mat Task<MatType>::renderBackgroundLayers() const {
+    if (!_backgroundImage.empty()) {
+        return _backgroundImage;
+    }
+    const Background& layers = _outputConfig.background;
+    if (layers.isFlat()) {
+        return {};
+    }
+
+    cv::Mat background = renderBackground(_outputConfig);
+    if (layers.hasShadow()) {
+        // device alpha, screen area is transparent in template, but covered by video
+        cv::Mat inverseAlpha, silhouette;
+        cv::extractChannel(_assets->mask, inverseAlpha, 0);
+        inverseAlpha.convertTo(silhouette, CV_32F, -1.0 / transparentMaskValue(), 1.0);
+        cv::Point frameOrigin(_frameOriginX, _frameOriginY);
+        silhouette(screenRect() - frameOrigin).setTo(1.0);
+        applyDropShadow(background, layers, silhouette, cv::Rect(frameOrigin, silhouette.size()));
+    }
+
+    return background;
+}
+
+template<class MatType>
+void Task<MatType>::prepareStaticFrame() {
+    // output with empty screen contains every static pixel
+    // (cv::Mat tasks blend it on initialization, before screen is ever written)
+    if (!_outputConfig.compactMemory) {
+        if constexpr (std::is_same_v<MatType, cv::UMat>) {
+            blendFrame();
+        }
+        packFrame();
+    }
+    cv::Mat frame;
+    _outputFrame.copyTo(frame);
+
+    // pixels inside screen bounds, which are not fully covered by device frame, change every frame
+    cv::Rect screenRect(_screenOriginX, _screenOriginY, _screenWidth, _screenHeight);
+    cv::Rect screenInFrameRect = screenRect - cv::Point(_frameOriginX, _frameOriginY);
+    cv::Mat inverseAlpha;
+    cv::extractChannel(_assets->mask(screenInFrameRect), inverseAlpha, 0);
+    cv::Mat staticMask(frame.size(), CV_8UC1, cv::Scalar(255));
+    staticMask(screenRect).setTo(0, inverseAlpha > 0);
+
+    _outputWriter->setStaticFrame(frame, staticMask);
 }
 
 template<class MatType>
 void Task<MatType>::feedFrame(MatType &rawFrame) {
+    composeFrame(rawFrame);
+    {
+        SF_PROFILE_STAGE(Stage::Encode);
+        writeFrame();
+    }
+}
+
+template<class MatType>
+void Task<MatType>::composeFrame(MatType &rawFrame) {
     if (!isActive()) {
         throw std::runtime_error("Task is not active");
     }
 
-    // frame resize +  float convertion
-    cv::resize(rawFrame, _u8Frame, {_screenWidth, _screenHeight});
+    {
+        SF_PROFILE_STAGE(Stage::Resize);
+        resizeFrame(rawFrame);
+    }
+    {
+        SF_PROFILE_STAGE(Stage::Blend);
+        blendFrame();
+    }
+    {
+        SF_PROFILE_STAGE(Stage::Pack);
+        packFrame();
+    }
+}
+
+template<class MatType>
+void Task<MatType>::selectResizeMethod(cv::Size inputSize) {
+    _inputSize = inputSize;
+    cv::Size screenSize(_screenWidth, _screenHeight);
+    // input size in screen orientation
+    cv::Size uprightSize = _frameRotation % 180 == 0 ? inputSize : cv::Size(inputSize.height, inputSize.width);
+    int ratio = uprightSize.width / _screenWidth;
+    _identityResize = uprightSize == screenSize;
+    if (!_identityResize && ratio >= 2 && uprightSize == screenSize * ratio && _frameRotation == 0) {
+        // integer downscale (recordings are often 2x/3x of screen), area filter
+        // is then exact box averaging, done by specialized (vectorized) opencv kernel
+        _interpolation = cv::INTER_AREA;
+    } else {
+        switch (_outputConfig.scaleFilter) {
+            case ScaleFilter::Area: _interpolation = cv::INTER_AREA; break;
+            case ScaleFilter::Lanczos: _interpolation = cv::INTER_LANCZOS4; break;
+            default: _interpolation = cv::INTER_LINEAR; break;
+        }
+    }
+
+    if (_frameRotation != 0 && !_identityResize) {
+        // rotation of pixel centers (x, y) in input frame, followed by scaling to screen
+        double w = inputSize.width, h = inputSize.height;
+        cv::Matx23d rotation;
+        switch (_frameRotation) {
+            case 90: rotation = cv::Matx23d(0, -1, h - 1, 1, 0, 0); break;
+            case 180: rotation = cv::Matx23d(-1, 0, w - 1, 0, -1, h - 1); break;
+            default: rotation = cv::Matx23d(0, 1, 0, -1, 0, w - 1); break;
+        }
+        double sx = (double) _screenWidth / uprightSize.width;
+        double sy = (double) _screenHeight / uprightSize.height;
+        _rotationTransform = (cv::Mat_<double>(2, 3) <<
+            sx * rotation(0, 0), sx * rotation(0, 1), sx * rotation(0, 2) + 0.5 * sx - 0.5,
+            sy * rotation(1, 0), sy * rotation(1, 1), sy * rotation(1, 2) + 0.5 * sy - 0.5);
+        // area filter is not available for affine warps
+        if (_interpolation == cv::INTER_AREA) {
+            _interpolation = cv::INTER_LINEAR;
+        }
+    }
+    DEBUG_PRINTLN("*** Input frame dimensions: [" << inputSize.width << ", " << inputSize.height << "], rotation: "
+                  << _frameRotation << ", resize: "
+                  << (_identityResize ? "identity" : "interpolation " + std::to_string(_interpolation)));
+}
+
+template<class MatType>
+void Task<MatType>::fitFrame(MatType &rawFrame, MatType &dst) {
+    cv::Size screenSize(_screenWidth, _screenHeight);
+    if (_frameRotation != 0) {
+        if (_identityResize) {
+            int rotateCode = _frameRotation == 90 ? cv::ROTATE_90_CLOCKWISE
+                : (_frameRotation == 180 ? cv::ROTATE_180 : cv::ROTATE_90_COUNTERCLOCKWISE);
+            cv::rotate(rawFrame, dst, rotateCode);
+        } else {
+            // rotation and resize in single pass
+            cv::warpAffine(rawFrame, dst, _rotationTransform, screenSize, _interpolation, cv::BORDER_REPLICATE);
+        }
+    } else if (_identityResize) {
+        rawFrame.copyTo(dst);
+    } else {
+        cv::resize(rawFrame, dst, screenSize, 0, 0, _interpolation);
+    }
+}
+
+template<class MatType>
+void Task<MatType>::resizeFrame(MatType &rawFrame) {
+    if (rawFrame.size() != _inputSize) {
+        selectResizeMethod(rawFrame.size());
+    }
 
-    // embed float frame inside output frame, in screen bounds
     cv::Rect screenRect(_screenOriginX, _screenOriginY, _screenWidth, _screenHeight);
-    _u8Frame.convertTo(_screenFrame(screenRect), CV_32F);
+    if (_outputConfig.deepColor && rawFrame.depth() == CV_8U) {
+        // 8-bit input in 16-bit output, resized and scaled to 16 bits
+        MatType screen = _outputFrame(screenRect);
+        fitFrame(rawFrame, _u8Frame);
+        _u8Frame.convertTo(screen, CV_16U, 257.0);
+    } else if (_outputConfig.compactMemory) {
+        // resize straight into output frame, blending happens there
+        MatType screen = _outputFrame(screenRect);
+        fitFrame(rawFrame, screen);
+    } else {
+        // cv::Mat tasks blend screen edges in place, device tasks blend separate bottom layer
+        MatType& floatScreen = std::is_same_v<MatType, cv::Mat> ? _outputFloatFrame : _screenFrame;
+        if (_identityResize && _frameRotation == 0) {
+            // float convertion only, embedded straight in screen bounds
+            rawFrame.convertTo(floatScreen(screenRect), CV_32F);
+        } else {
+            // frame resize +  float convertion
+            fitFrame(rawFrame, _u8Frame);
+
+            // embed float frame inside output frame, in screen bounds
+            _u8Frame.convertTo(floatScreen(screenRect), CV_32F);
+        }
+    }
+}
+
+template<class MatType>
+void Task<MatType>::blendFrame() {
+    if (_outputConfig.compactMemory) {
+        // only screen area, rest of output frame is static
+        if constexpr (std::is_same_v<MatType, cv::Mat>) {
+            cv::Rect screenRect(_screenOriginX, _screenOriginY, _screenWidth, _screenHeight);
+            cv::Rect screenInFrameRect = screenRect - cv::Point(_frameOriginX, _frameOriginY);
+            if (_outputConfig.deepColor) {
+                _deepScreenCompositor.apply(_outputFrame(screenRect), _assets->device(screenInFrameRect));
+            } else {
+                _screenCompositor.apply(_outputFrame(screenRect), _assets->device(screenInFrameRect));
+            }
+        }
+        return;
+    }
+
+    if constexpr (std::is_same_v<MatType, cv::Mat>) {
+        // only screen edges, rest of device frame was blended on initialization
+        cv::Rect screenInFrameRect = screenRect() - cv::Point(_frameOriginX, _frameOriginY);
+        _floatScreenCompositor.apply(_outputFloatFrame(screenRect()), _assets->device(screenInFrameRect));
+        return;
+    }
 
     // alpha blending
     cv::Rect frameRect(_frameOriginX, _frameOriginY, _frameWidth, _frameHeight);
-    cv::multiply(_screenFrame(frameRect), _mask, _outputFloatFrame(frameRect));
-    cv::add(_outputFloatFrame(frameRect), _device, _outputFloatFrame(frameRect));
+    cv::multiply(_screenFrame(frameRect), _assets->mask, _outputFloatFrame(frameRect));
+    cv::add(_outputFloatFrame(frameRect), _assets->device, _outputFloatFrame(frameRect));
+}
+
+template<class MatType>
+void Task<MatType>::packFrame() {
+    // back to uint8 (compact mode blends directly in uint8)
+    if (!_outputConfig.compactMemory) {
+        _outputFloatFrame.convertTo(_outputFrame, CV_8U);
+    }
 
-    // back to uint8
-    _outputFloatFrame.convertTo(_outputFrame, CV_8U);
+    if constexpr (std::is_same_v<MatType, cv::UMat>) {
+        // template buffers stay on device, only final 8-bit frame is downloaded
+        _outputFrame.copyTo(_hostOutputFrame);
+    }
+}
 
+template<class MatType>
+void Task<MatType>::writeFrame() {
     // write generated frame to writer
-    _outputWriter.write(_outputFrame);
+    if constexpr (std::is_same_v<MatType, cv::UMat>) {
+        _outputWriter->write(_hostOutputFrame);
+    } else {
+        _outputWriter->write(_outputFrame);
+    }
+}
+
+template<class MatType>
+cv::Mat Task<MatType>::coverageMask() const {
+    // inverse alpha is exactly one (or 255, 65535) where template is fully transparent
+    cv::Mat inverseAlpha;
+    cv::extractChannel(_assets->mask, inverseAlpha, 0);
+    double transparent = transparentMaskValue();
+    cv::Mat coverage(_outputConfig.height, _outputConfig.width, CV_8UC1, cv::Scalar(0));
+    cv::Rect frameRect(_frameOriginX, _frameOriginY, _frameWidth, _frameHeight);
+    coverage(frameRect).setTo(255, inverseAlpha < transparent);
+    coverage(screenRect()).setTo(255);
+
+    return coverage;
+}
+
+template<class MatType>
+double Task<MatType>::transparentMaskValue() const {
+    if (_outputConfig.deepColor) {
+        return 65535.0;
+    }
+    return _outputConfig.compactMemory ? 255.0 : 1.0;
+}
+
+template<class MatType>
+size_t Task<MatType>::allocatedBytes() const {
+    size_t bytes = 0;
+    for (const MatType* mat : {&_u8Frame, &_screenFrame, &_outputFloatFrame, &_outputFrame}) {
+        bytes += mat->total() * mat->elemSize();
+    }
+    bytes += _hostOutputFrame.total() * _hostOutputFrame.elemSize();
+
+    return bytes;
+}
+
+template<class MatType>
+size_t Task<MatType>::sharedBytes() const {
+    return _assets->allocatedBytes();
+}
+
+template<class MatType>
+cv::Size Task<MatType>::screenSize() const {
+    return {_screenWidth, _screenHeight};
+}
+
+template<class MatType>
+cv::Rect Task<MatType>::screenRect() const {
+    return {_screenOriginX, _screenOriginY, _screenWidth, _screenHeight};
 }
 
 template<class MatType>
 bool Task<MatType>::isActive() const {
-    return _outputWriter.isOpened();
+    return _outputWriter != nullptr && _outputWriter->isOpened();
 }
 
 template<class MatType>
 void Task<MatType>::finalize() {
-    _outputWriter.release();
+    if (_outputWriter != nullptr) {
+        _outputWriter->release();
+    }
 }
 
 // explicit instantiation
+template struct TemplateAssets<cv::Mat>;
+template struct TemplateAssets<cv::UMat>;
 template class Task<cv::Mat>;
 template class Task<cv::UMat>;
 
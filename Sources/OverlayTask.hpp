@@ -6,31 +6,81 @@
 #define SCREENFRAMER_OVERLAYTASK_HPP
 
 #include <opencv2/core.hpp>
-#include <opencv2/videoio.hpp>
+#include <memory>
 #include "OutputConfig.hpp"
+#include "FrameWriter.hpp"
+#include "Compositor.hpp"
 
 namespace avo {
 
 struct OverlayConfig;
 
+/**
+ * Device frame (template) prepared for blending at given size
+ * Immutable after creation, so single instance is shared by all tasks of the same frame size
+ */
+template<class MatType>
+struct TemplateAssets {
+    // size of source template image, after rotation
+    cv::Size templateSize;
+    // device frame as bgr, premultiplied by alpha
+    // (CV_32FC3, or CV_8UC3 / CV_16UC3 in compact memory / deep color mode)
+    MatType device;
+    // inverted device frame mask (alpha)
+    // (CV_32FC3, or CV_8UC1 / CV_16UC1 in compact memory / deep color mode)
+    MatType mask;
+
+    /**
+     * Rotates device frame and mask, resizes them to frameSize and converts them for blending
+     * @param device CV_8UC3 template image
+     * @param mask CV_8UC1 template alpha
+     * @param frameSize size of device frame in output
+     * @param rotation clockwise rotation of template in degrees (multiple of 90)
+     * @param compactMemory prepare 8-bit assets for compact memory mode
+     * @param deepColor prepare 16-bit assets for compact memory mode (with compactMemory)
+     * @param colorInfo colorimetry of video, into which device colors are converted in deep color mode
+     */
+    static std::shared_ptr<const TemplateAssets> prepare(
+        const cv::Mat& device,
+        const cv::Mat& mask,
+        cv::Size frameSize,
+        int rotation,
+        bool compactMemory,
+        bool deepColor = false,
+        const ColorInfo& colorInfo = {}
+    );
+    size_t allocatedBytes() const;
+};
+
+// size of device frame (template without padding) in output
+cv::Size templateFrameSize(const OutputConfig& outputConfig);
+
 template<class MatType>
 class Task {
 private:
     OutputConfig _outputConfig;
-    cv::VideoWriter _outputWriter;
-    // device frame as bgr
-    MatType _device;
-    // device frame mask (alpha) in 3-channel
-    MatType _mask;
-    // CV_8UC3 mat for resized video-frames
+    std::unique_ptr<FrameWriter> _outputWriter;
+    // prepared device frame and mask, possibly shared with other tasks
+    std::shared_ptr<const TemplateAssets<MatType>> _assets;
+    // CV_8UC3 mat for resized video-frames (8-bit frames in deep color mode)
     MatType _u8Frame;
-    // float bottom layer (background + screen)
+    // float bottom layer (background + screen) of device (cv::UMat) tasks
     MatType _screenFrame;
     // float and u8 mats for storing result
     MatType _outputFloatFrame;
     MatType _outputFrame;
+    // host copy of output frame for device (cv::UMat) tasks
+    cv::Mat _hostOutputFrame;
+    // blending of screen area with device frame in compact memory mode
+    Compositor<PixelFormat::BGR24, BlendPolicy::EdgeOnly> _screenCompositor;
+    // the same for 16-bit frames in deep color mode
+    Compositor<PixelFormat::BGR48, BlendPolicy::EdgeOnly> _deepScreenCompositor;
+    // the same for float frames of default (cv::Mat) tasks
+    Compositor<PixelFormat::BGR96F, BlendPolicy::EdgeOnly> _floatScreenCompositor;
     // bgr background color
     cv::Scalar _backgroundColor;
+    // background given by setBackground, empty - background of output config
+    cv::Mat _backgroundImage;
     // offset of device frame (template)
     int _frameOriginX;
     int _frameOriginY;
@@ -43,6 +93,16 @@ private:
     // dimensions of device frame (template)
     int _frameWidth;
     int _frameHeight;
+    // input frame size for which resize method was selected
+    cv::Size _inputSize;
+    // input frames match screen size, so they are embedded without resampling
+    bool _identityResize = false;
+    // cv::resize interpolation used otherwise
+    int _interpolation = 0;
+    // clockwise rotation of input frames (0, 90, 180, 270)
+    int _frameRotation;
+    // input frame -> screen mapping, when frames are rotated and resized in single pass
+    cv::Mat _rotationTransform;
 public:
     Task(
         const cv::Mat &device,
@@ -50,11 +110,58 @@ public:
         const OverlayConfig &overlayConfig,
         const OutputConfig &outputConfig
     );
+    Task(
+        std::shared_ptr<const TemplateAssets<MatType>> assets,
+        const OverlayConfig &overlayConfig,
+        const OutputConfig &outputConfig
+    );
 
+    /**
+     * Replaces background layers of output config with given image, e.g. crop of scene canvas,
+     * so that antialiased edges of device are blended over it (has to be called before initialize)
+     * @param background CV_32FC3 bgr image of output size
+     */
+    void setBackground(const cv::Mat& background);
     void initialize();
+    // initializes task with given writer instead of one selected by output path extension
+    void initialize(std::unique_ptr<FrameWriter> writer);
     virtual void feedFrame(MatType &rawFrame);
+    // overlays frame without passing it to writer (resize, blend and pack stages)
+    void composeFrame(MatType &rawFrame);
+
+    // Individual stages of feedFrame, in order (exposed for benchmarking)
+    // resizes video-frame into screen bounds
+    void resizeFrame(MatType &rawFrame);
+    // alpha blending of screen with device frame
+    void blendFrame();
+    // conversion of blended frame to 8-bit output
+    void packFrame();
+    // passes output frame to writer
+    void writeFrame();
+
     bool isActive() const;
     void finalize();
+    // size of screen area in output frame, input frames are resized to it
+    cv::Size screenSize() const;
+    // position and size of screen area in output frame
+    cv::Rect screenRect() const;
+    // CV_8UC1 mask of output pixels covered by device (nonzero device frame alpha or screen area)
+    cv::Mat coverageMask() const;
+    // number of bytes held by task frame buffers (excluding shared template assets)
+    size_t allocatedBytes() const;
+    // number of bytes held by template assets, which may be shared with other tasks
+    size_t sharedBytes() const;
+private:
+    // selects resize method for input frames of given size
+    void selectResizeMethod(cv::Size inputSize);
+    // rotates and resizes input frame into dst of screen size
+    void fitFrame(MatType &rawFrame, MatType &dst);
+    // passes static part of output to writer (see FrameWriter::setStaticFrame)
+    void prepareStaticFrame();
+    // CV_32FC3 background with image, gradient and drop shadow, empty if background is flat color
+    cv::Mat renderBackgroundLayers() const;
+    // value of fully transparent pixel in inverted template alpha (1.0, 255 or 65535)
+    double transparentMaskValue() const;
 };
 
 }; // namespace avo
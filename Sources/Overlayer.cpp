@@ -7,6 +7,7 @@
 #include <opencv2/imgproc.hpp>
 #include <iostream>
 #include <filesystem>
+#include <type_traits>
 
 namespace avo {
 
@@ -37,7 +38,49 @@ int OverlayConfig::screenHeight() const {
     return screenBottom - screenTop;
 }
 
-Overlayer::Overlayer(const OverlayConfig &config) : _config(config) {
+OverlayConfig OverlayConfig::rotated(int degrees) const {
+    int w = templateWidth, h = templateHeight;
+    switch (normalizeRotation(degrees)) {
+        case 0:
+            return *this;
+        case 90:
+            return {imagePath, h - screenBottom, screenLeft, h - screenTop, screenRight, h, w};
+        case 180:
+            return {imagePath, w - screenRight, h - screenBottom, w - screenLeft, h - screenTop, w, h};
+        case 270:
+            return {imagePath, screenTop, w - screenRight, screenBottom, w - screenLeft, h, w};
+        default:
+            throw std::invalid_argument("Rotation must be multiple of 90 degrees");
+    }
+}
+
+// TemplateAssetsKey
+
+bool TemplateAssetsKey::operator==(const TemplateAssetsKey& other) const {
+    return frameWidth == other.frameWidth && frameHeight == other.frameHeight
+        && rotation == other.rotation && compactMemory == other.compactMemory && deepColor == other.deepColor
+        && primaries == other.primaries && transfer == other.transfer;
+}
+
+size_t TemplateAssetsKeyHash::operator()(const TemplateAssetsKey& key) const {
+    size_t hash = std::hash<int>()(key.frameWidth);
+    hash = hash * 31 + std::hash<int>()(key.frameHeight);
+    hash = hash * 31 + std::hash<int>()(key.rotation);
+    hash = hash * 31 + std::hash<int>()(key.primaries * 256 + key.transfer);
+    return hash * 31 + (key.compactMemory ? 1 : 0) + (key.deepColor ? 2 : 0);
+}
+
+// Overlayer
+
+template<class MatType>
+static size_t assetsCost(const std::shared_ptr<const TemplateAssets<MatType>>& assets) {
+    return assets->allocatedBytes();
+}
+
+Overlayer::Overlayer(const OverlayConfig &config, size_t assetsCacheBytes)
+    : _config(config),
+      _hostAssets(assetsCacheBytes, assetsCost<cv::Mat>),
+      _deviceAssets(assetsCacheBytes, assetsCost<cv::UMat>) {
     cv::Mat bgraImage = cv::imread(config.imagePath, cv::IMREAD_UNCHANGED);
     if (bgraImage.empty()) {
         throw std::invalid_argument("File is not image: " + config.imagePath);
@@ -57,7 +100,31 @@ OverlayConfig Overlayer::config() const {
 
 template<class MatType>
 Task<MatType> Overlayer::overlayTask(const OutputConfig &outputConfig) {
-    return Task<MatType>(_backgroundImage, _mask, _config, outputConfig);
+    cv::Size frameSize = templateFrameSize(outputConfig);
+    int rotation = normalizeRotation(outputConfig.templateRotation);
+    // SDR assets do not depend on colorimetry of video
+    ColorInfo colorInfo = outputConfig.deepColor ? outputConfig.colorInfo : ColorInfo();
+    TemplateAssetsKey key = {
+        frameSize.width, frameSize.height, rotation, outputConfig.compactMemory, outputConfig.deepColor,
+        colorInfo.primaries, colorInfo.transfer
+    };
+    auto prepare = [&]() {
+        return TemplateAssets<MatType>::prepare(
+            _backgroundImage, _mask, frameSize, rotation, outputConfig.compactMemory, outputConfig.deepColor, colorInfo
+        );
+    };
+    std::shared_ptr<const TemplateAssets<MatType>> assets;
+    if constexpr (std::is_same_v<MatType, cv::UMat>) {
+        assets = _deviceAssets.getOrCreate(key, prepare);
+    } else {
+        assets = _hostAssets.getOrCreate(key, prepare);
+    }
+
+    return Task<MatType>(assets, _config, outputConfig);
+}
+
+size_t Overlayer::cachedAssetsBytes() const {
+    return _hostAssets.cost() + _deviceAssets.cost();
 }
 
 // explicit instantiation
@@ -8,8 +8,10 @@
 #include <opencv2/core.hpp>
 #include <string>
 #include <cstdint>
+#include <memory>
 #include "OverlayTask.hpp"
 #include "OutputConfig.hpp"
+#include "LRUCache.hpp"
 
 namespace avo {
 
@@ -36,20 +38,57 @@ struct OverlayConfig {
     bool isValid() const;
     int screenWidth() const;
     int screenHeight() const;
+    // config of template rotated clockwise by multiple of 90 degrees
+    OverlayConfig rotated(int degrees) const;
+};
+
+// Identifies prepared template assets: size of device frame in output (includes padding) and buffer format
+struct TemplateAssetsKey {
+    int frameWidth;
+    int frameHeight;
+    int rotation;
+    bool compactMemory;
+    bool deepColor;
+    // colorimetry into which device colors are converted (deep color mode only, unspecified otherwise)
+    int primaries;
+    int transfer;
+
+    bool operator==(const TemplateAssetsKey& other) const;
+};
+
+struct TemplateAssetsKeyHash {
+    size_t operator()(const TemplateAssetsKey& key) const;
 };
 
 class Overlayer {
+public:
+    // default limit of memory held by prepared template assets
+    static constexpr size_t DEFAULT_ASSETS_CACHE_BYTES = 256 * 1024 * 1024;
 private:
+    template<class MatType>
+    using AssetsCache = LRUCache<TemplateAssetsKey, std::shared_ptr<const TemplateAssets<MatType>>, TemplateAssetsKeyHash>;
+
     OverlayConfig _config;
+    // template assets prepared for previously requested output sizes, per backend
+    AssetsCache<cv::Mat> _hostAssets;
+    AssetsCache<cv::UMat> _deviceAssets;
 protected:
     cv::Mat _backgroundImage;
     cv::Mat _mask;
 public:
-    explicit Overlayer(const OverlayConfig &config);
+    /**
+     * @param config template configuration
+     * @param assetsCacheBytes limit of memory held by cached template assets
+     * (most recently used assets are kept even if they exceed it)
+     */
+    explicit Overlayer(const OverlayConfig &config, size_t assetsCacheBytes = DEFAULT_ASSETS_CACHE_BYTES);
     OverlayConfig config() const;
 
+    // creates task for given output, thread-safe
     template<class MatType>
     Task<MatType> overlayTask(const OutputConfig& outputConfig);
+    // bytes held by cached template assets
+    size_t cachedAssetsBytes() const;
 };
 
 } // namespace avo
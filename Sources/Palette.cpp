@@ -0,0 +1,181 @@
+#include "Palette.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace avo {
+
+// ColorHistogram
+
+ColorHistogram::ColorHistogram(): _counts(BINS, 0) {}
+
+void ColorHistogram::add(const cv::Mat& image, const cv::Mat& mask, int step) {
+    CV_Assert(image.type() == CV_8UC3);
+    CV_Assert(mask.empty() || (mask.type() == CV_8UC1 && mask.size() == image.size()));
+    step = std::max(step, 1);
+    for (int y = 0; y < image.rows; y += step) {
+        const auto* row = image.ptr<cv::Vec3b>(y);
+        const uint8_t* maskRow = mask.empty() ? nullptr : mask.ptr<uint8_t>(y);
+        for (int x = 0; x < image.cols; x += step) {
+            if (maskRow != nullptr && maskRow[x] == 0) {
+                continue;
+            }
+            const cv::Vec3b& px = row[x];
+            _counts[binOf(px[0], px[1], px[2])] += 1;
+        }
+    }
+}
+
+void ColorHistogram::clear() {
+    std::fill(_counts.begin(), _counts.end(), 0);
+}
+
+const std::vector<uint32_t>& ColorHistogram::counts() const {
+    return _counts;
+}
+
+// Palette (median cut)
+
+namespace {
+
+struct BinColor {
+    uint8_t c[3]; // b, g, r (BITS wide)
+    uint32_t count;
+};
+
+struct Box {
+    size_t begin;
+    size_t end;
+    uint64_t population;
+    int longestAxis;
+    int range;
+};
+
+Box makeBox(std::vector<BinColor>& bins, size_t begin, size_t end) {
+    int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+    uint64_t population = 0;
+    for (size_t i = begin; i < end; i++) {
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], (int) bins[i].c[c]);
+            hi[c] = std::max(hi[c], (int) bins[i].c[c]);
+        }
+        population += bins[i].count;
+    }
+    int axis = 0;
+    for (int c = 1; c < 3; c++) {
+        if (hi[c] - lo[c] > hi[axis] - lo[axis]) {
+            axis = c;
+        }
+    }
+    return {begin, end, population, axis, hi[axis] - lo[axis]};
+}
+
+}
+
+Palette Palette::fromHistogram(const ColorHistogram& histogram, int maxColors) {
+    constexpr int BITS = ColorHistogram::BITS;
+    constexpr int MASK = (1 << BITS) - 1;
+    const auto& counts = histogram.counts();
+    std::vector<BinColor> bins;
+    for (int bin = 0; bin < ColorHistogram::BINS; bin++) {
+        if (counts[bin] > 0) {
+            BinColor color = {{
+                (uint8_t) (bin & MASK),
+                (uint8_t) ((bin >> BITS) & MASK),
+                (uint8_t) ((bin >> (2 * BITS)) & MASK)
+            }, counts[bin]};
+            bins.push_back(color);
+        }
+    }
+
+    Palette palette;
+    if (bins.empty() || maxColors <= 0) {
+        return palette;
+    }
+
+    // split box with largest range weighted by population until color limit is reached
+    std::vector<Box> boxes = {makeBox(bins, 0, bins.size())};
+    while ((int) boxes.size() < maxColors) {
+        auto it = std::max_element(boxes.begin(), boxes.end(), [](const Box& a, const Box& b) {
+            return (double) a.range * a.population < (double) b.range * b.population;
+        });
+        if (it->range == 0 || it->end - it->begin < 2) {
+            break;
+        }
+
+        Box box = *it;
+        int axis = box.longestAxis;
+        std::sort(bins.begin() + box.begin, bins.begin() + box.end, [axis](const BinColor& a, const BinColor& b) {
+            return a.c[axis] < b.c[axis];
+        });
+        // weighted median
+        uint64_t acc = 0;
+        size_t split = box.begin + 1;
+        for (size_t i = box.begin; i < box.end - 1; i++) {
+            acc += bins[i].count;
+            split = i + 1;
+            if (acc * 2 >= box.population) {
+                break;
+            }
+        }
+        *it = makeBox(bins, box.begin, split);
+        boxes.push_back(makeBox(bins, split, box.end));
+    }
+
+    // palette color is population weighted mean of box
+    constexpr int SHIFT = 8 - BITS;
+    for (const Box& box : boxes) {
+        uint64_t sum[3] = {0, 0, 0};
+        for (size_t i = box.begin; i < box.end; i++) {
+            for (int c = 0; c < 3; c++) {
+                sum[c] += (uint64_t) ((bins[i].c[c] << SHIFT) + (1 << (SHIFT - 1))) * bins[i].count;
+            }
+        }
+        cv::Vec3b color;
+        for (int c = 0; c < 3; c++) {
+            color[c] = (uint8_t) std::min<uint64_t>(255, (sum[c] + box.population / 2) / box.population);
+        }
+        palette.colors.push_back(color);
+    }
+
+    return palette;
+}
+
+int Palette::nearest(const cv::Vec3b& color) const {
+    int best = 0;
+    int bestDistance = std::numeric_limits<int>::max();
+    for (size_t i = 0; i < colors.size(); i++) {
+        int db = (int) color[0] - colors[i][0];
+        int dg = (int) color[1] - colors[i][1];
+        int dr = (int) color[2] - colors[i][2];
+        int distance = db * db + dg * dg + dr * dr;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = (int) i;
+        }
+    }
+
+    return best;
+}
+
+// PaletteMapper
+
+PaletteMapper::PaletteMapper(const Palette& palette, int indexOffset)
+    : _palette(&palette), _indexOffset(indexOffset), _lut(ColorHistogram::BINS, EMPTY) {}
+
+uint16_t PaletteMapper::lookup(int bin) {
+    constexpr int BITS = ColorHistogram::BITS;
+    constexpr int MASK = (1 << BITS) - 1;
+    constexpr int SHIFT = 8 - BITS;
+    constexpr int HALF = 1 << (SHIFT - 1);
+    cv::Vec3b center(
+        (uint8_t) (((bin & MASK) << SHIFT) + HALF),
+        (uint8_t) ((((bin >> BITS) & MASK) << SHIFT) + HALF),
+        (uint8_t) ((((bin >> (2 * BITS)) & MASK) << SHIFT) + HALF)
+    );
+    auto index = (uint16_t) (_palette->nearest(center) + _indexOffset);
+    _lut[bin] = index;
+
+    return index;
+}
+
+} // namespace avo
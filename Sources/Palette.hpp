@@ -0,0 +1,79 @@
+#ifndef SCREENFRAMER_PALETTE_HPP
+#define SCREENFRAMER_PALETTE_HPP
+
+#include <opencv2/core.hpp>
+#include <array>
+#include <vector>
+#include <cstdint>
+
+namespace avo {
+
+// Color histogram with 5 bits per channel
+class ColorHistogram {
+public:
+    static constexpr int BITS = 5;
+    static constexpr int BINS = 1 << (3 * BITS);
+private:
+    std::vector<uint32_t> _counts;
+public:
+    ColorHistogram();
+
+    /**
+     * Adds pixels of BGR image to histogram
+     * @param image CV_8UC3 image
+     * @param mask optional CV_8UC1 mask, only nonzero pixels are counted
+     * @param step subsampling step in both dimensions
+     */
+    void add(const cv::Mat& image, const cv::Mat& mask = cv::Mat(), int step = 1);
+    void clear();
+    const std::vector<uint32_t>& counts() const;
+
+    static inline int binOf(uint8_t b, uint8_t g, uint8_t r) {
+        return ((r >> (8 - BITS)) << (2 * BITS)) | ((g >> (8 - BITS)) << BITS) | (b >> (8 - BITS));
+    }
+};
+
+// Fixed size list of BGR colors
+struct Palette {
+    std::vector<cv::Vec3b> colors;
+
+    /**
+     * Builds palette using median cut over histogram bins
+     * @param histogram source histogram
+     * @param maxColors maximum number of colors
+     */
+    static Palette fromHistogram(const ColorHistogram& histogram, int maxColors);
+
+    // index of nearest color (squared euclidean distance)
+    int nearest(const cv::Vec3b& color) const;
+};
+
+// Maps colors to palette indices using lazily filled histogram-bin lookup table
+class PaletteMapper {
+private:
+    static constexpr uint16_t EMPTY = 0xffff;
+    const Palette* _palette;
+    int _indexOffset;
+    std::vector<uint16_t> _lut;
+public:
+    /**
+     * @param palette palette to map colors to, must outlive mapper
+     * @param indexOffset value added to every returned index
+     */
+    PaletteMapper(const Palette& palette, int indexOffset = 0);
+
+    inline uint8_t map(uint8_t b, uint8_t g, uint8_t r) {
+        int bin = ColorHistogram::binOf(b, g, r);
+        uint16_t index = _lut[bin];
+        if (index == EMPTY) {
+            index = lookup(bin);
+        }
+        return (uint8_t) index;
+    }
+private:
+    uint16_t lookup(int bin);
+};
+
+} // namespace avo
+
+#endif //SCREENFRAMER_PALETTE_HPP
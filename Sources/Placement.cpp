@@ -0,0 +1,228 @@
+#include "Placement.hpp"
+#include "FramePool.hpp"
+#include "Debug.hpp"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <filesystem>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+namespace avo {
+
+static Placement processPlacement;
+
+CpuSet parseCpuList(const std::string& list) {
+    CpuSet cpus;
+    std::istringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        // sysfs lists end with newline
+        range.erase(range.find_last_not_of(" \n") + 1);
+        if (range.empty()) {
+            continue;
+        }
+        int first = -1, last = -1, consumed = 0;
+        size_t length = range.size();
+        bool isRange = std::sscanf(range.c_str(), "%d-%d%n", &first, &last, &consumed) == 2
+            && (size_t) consumed == length;
+        if (!isRange) {
+            consumed = 0;
+            bool isSingle = std::sscanf(range.c_str(), "%d%n", &first, &consumed) == 1 && (size_t) consumed == length;
+            last = isSingle ? first : -1;
+        }
+        if (first < 0 || last < first) {
+            throw std::invalid_argument("Invalid CPU list \"" + list + "\", expected e.g. 0-7,16-23");
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string formatCpuList(const CpuSet& cpus) {
+    std::ostringstream out;
+    for (size_t i = 0; i < cpus.size(); i++) {
+        size_t end = i;
+        while (end + 1 < cpus.size() && cpus[end + 1] == cpus[end] + 1) {
+            end++;
+        }
+        if (i > 0) {
+            out << ',';
+        }
+        out << cpus[i];
+        if (end > i) {
+            out << '-' << cpus[end];
+        }
+        i = end;
+    }
+    return out.str();
+}
+
+CpuSet numaNodeCpus(int node) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (node < 0 || !std::getline(file, list)) {
+        throw std::runtime_error("NUMA node " + std::to_string(node) + " does not exist");
+    }
+    return parseCpuList(list);
+}
+
+int numaNodeCount() {
+    int count = 0;
+    std::error_code error;
+    while (std::filesystem::exists("/sys/devices/system/node/node" + std::to_string(count), error)) {
+        count++;
+    }
+    return std::max(1, count);
+}
+
+int currentNumaNode() {
+#ifdef __linux__
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+        return (int) node;
+    }
+#endif
+    return 0;
+}
+
+// Placement
+
+bool Placement::isEmpty() const {
+    return decodeCpus.empty() && composeCpus.empty() && encodeCpus.empty() && numaNode < 0 && threads <= 0;
+}
+
+std::string Placement::description() const {
+    std::ostringstream out;
+    auto describe = [&out](const char* stage, const CpuSet& cpus) {
+        out << stage << ' ' << (cpus.empty() ? "any" : formatCpuList(cpus)) << ", ";
+    };
+    describe("decode", decodeCpus);
+    describe("compose", composeCpus);
+    describe("encode", encodeCpus);
+    if (numaNode >= 0) {
+        out << "node " << numaNode << ", ";
+    }
+    out << cv::getNumThreads() << " threads";
+    return out.str();
+}
+
+const CpuSet& Placement::cpusOf(Stage stage) const {
+    switch (stage) {
+        case Stage::Decode: return decodeCpus;
+        case Stage::Encode: return encodeCpus;
+        default: return composeCpus;
+    }
+}
+
+// Thread affinity
+
+#ifdef __linux__
+static bool setThreadCpus(const CpuSet& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+static CpuSet threadCpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CpuSet cpus;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+#else
+static bool setThreadCpus(const CpuSet&) {
+    return false;
+}
+
+static CpuSet threadCpus() {
+    return {};
+}
+#endif
+
+void applyPlacement(Placement placement) {
+    if (placement.numaNode >= 0) {
+        CpuSet nodeCpus = numaNodeCpus(placement.numaNode);
+        for (CpuSet* cpus : {&placement.decodeCpus, &placement.composeCpus, &placement.encodeCpus}) {
+            if (cpus->empty()) {
+                *cpus = nodeCpus;
+            }
+        }
+#ifdef __linux__
+        // pages of calling thread and threads created later come from node, while it has free memory
+        unsigned long mask[16] = {};
+        if ((size_t) placement.numaNode >= sizeof(mask) * 8) {
+            throw std::runtime_error("NUMA node " + std::to_string(placement.numaNode) + " is out of range");
+        }
+        mask[placement.numaNode / 64] |= 1ul << (placement.numaNode % 64);
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) != 0) {
+            DEBUG_PRINTLN("*** Unable to set preferred memory node " << placement.numaNode);
+        }
+#endif
+    }
+
+    if (!placement.composeCpus.empty() && !setThreadCpus(placement.composeCpus)) {
+        throw std::runtime_error("Unable to pin threads to CPUs " + formatCpuList(placement.composeCpus));
+    }
+    // setting thread count recreates OpenCV pool, its new workers inherit compose CPUs
+    if (placement.threads > 0) {
+        cv::setNumThreads(placement.threads);
+    } else if (!placement.composeCpus.empty()) {
+        cv::setNumThreads((int) placement.composeCpus.size());
+    }
+    // free frame buffers are reused only on node they were allocated on
+    if (numaNodeCount() > 1 && !placement.isEmpty()) {
+        FramePool::shared().setNumaAware(true);
+    }
+
+    processPlacement = std::move(placement);
+    DEBUG_PRINTLN("*** Placement: " << processPlacement.description());
+}
+
+const Placement& currentPlacement() {
+    return processPlacement;
+}
+
+// ScopedPlacement
+
+ScopedPlacement::ScopedPlacement(Stage stage) {
+    const CpuSet& cpus = processPlacement.cpusOf(stage);
+    if (cpus.empty()) {
+        return;
+    }
+    _previous = threadCpus();
+    _active = !_previous.empty() && _previous != cpus && setThreadCpus(cpus);
+}
+
+ScopedPlacement::~ScopedPlacement() {
+    if (_active) {
+        setThreadCpus(_previous);
+    }
+}
+
+} // namespace avo
@@ -0,0 +1,80 @@
+#ifndef SCREENFRAMER_PLACEMENT_HPP
+#define SCREENFRAMER_PLACEMENT_HPP
+
+#include <string>
+#include <vector>
+#include "Profiler.hpp"
+
+namespace avo {
+
+// sorted, unique CPU indices
+using CpuSet = std::vector<int>;
+
+/**
+ * Parses CPU list in kernel format, e.g. "0-7,16-23"
+ * @throws std::invalid_argument if list is malformed
+ */
+CpuSet parseCpuList(const std::string& list);
+std::string formatCpuList(const CpuSet& cpus);
+
+/**
+ * CPUs of NUMA node (Linux only)
+ * @throws std::runtime_error if node does not exist
+ */
+CpuSet numaNodeCpus(int node);
+// number of NUMA nodes, 1 if unknown
+int numaNodeCount();
+// NUMA node of CPU running calling thread, 0 if unknown
+int currentNumaNode();
+
+/**
+ * CPU sets, on which pipeline stages run. Empty set leaves stage unpinned.
+ * Decoder and encoder threads are created by libraries while input/output is opened,
+ * so they inherit CPU set of thread opening it. Everything else (resize, blend, pack,
+ * OpenCV thread pool) runs on compose CPUs.
+ */
+struct Placement {
+    CpuSet decodeCpus;
+    CpuSet composeCpus;
+    CpuSet encodeCpus;
+    // node frame buffers are preferably allocated on, -1 - node of allocating thread
+    int numaNode = -1;
+    // cap of OpenCV thread pool, 0 - number of compose CPUs (or OpenCV default if unpinned)
+    int threads = 0;
+
+    bool isEmpty() const;
+    // e.g. "decode 0-3, compose 4-15, encode 0-3, node 0, 12 threads"
+    std::string description() const;
+    const CpuSet& cpusOf(Stage stage) const;
+};
+
+/**
+ * Applies placement to process: pins calling thread to compose CPUs (threads created later,
+ * including OpenCV pool, inherit it), caps OpenCV threads and sets preferred memory node.
+ * Has to be called from main thread before processing threads are started.
+ * Missing CPU sets of stages are filled with CPUs of numaNode, if given.
+ * @throws std::runtime_error if placement can't be applied
+ */
+void applyPlacement(Placement placement);
+// placement applied to process (empty by default)
+const Placement& currentPlacement();
+
+/**
+ * Pins calling thread to CPUs of given stage for lifetime of scope, e.g. while opening
+ * decoder, so that threads it creates inherit them. Restores previous CPU set on exit.
+ * Does nothing if stage is unpinned.
+ */
+class ScopedPlacement {
+private:
+    CpuSet _previous;
+    bool _active = false;
+public:
+    explicit ScopedPlacement(Stage stage);
+    ~ScopedPlacement();
+    ScopedPlacement(const ScopedPlacement&) = delete;
+    ScopedPlacement& operator=(const ScopedPlacement&) = delete;
+};
+
+} // namespace avo
+
+#endif //SCREENFRAMER_PLACEMENT_HPP
@@ -0,0 +1,217 @@
+#include "Profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace avo {
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::Decode: return "decode";
+        case Stage::Upload: return "upload";
+        case Stage::Resize: return "resize";
+        case Stage::Blend: return "blend";
+        case Stage::Pack: return "pack";
+        case Stage::Encode: return "encode";
+        default: return "unknown";
+    }
+}
+
+namespace {
+
+constexpr size_t RING_CAPACITY = 1 << 16;
+constexpr size_t STAGE_COUNT = (size_t) Stage::Count;
+
+struct Event {
+    // nullptr for stage events
+    const char* counterName;
+    Stage stage;
+    int64_t start;
+    // end for stage events, value for counters
+    int64_t value;
+};
+
+struct CounterStats {
+    const char* name;
+    int64_t max = 0;
+    int64_t sum = 0;
+    int64_t samples = 0;
+};
+
+struct ThreadBuffer {
+    // uncontended, except while summary or trace reads buffer
+    std::mutex mutex;
+    int threadIndex;
+    std::vector<Event> ring = std::vector<Event>(RING_CAPACITY);
+    size_t written = 0;
+    std::array<int64_t, STAGE_COUNT> totalTime = {};
+    std::array<int64_t, STAGE_COUNT> calls = {};
+    std::vector<CounterStats> counters;
+
+    void push(const Event& event) {
+        ring[written % RING_CAPACITY] = event;
+        written += 1;
+    }
+};
+
+// buffers outlive their threads, so that summary includes finished workers
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+const auto epoch = std::chrono::steady_clock::now();
+
+ThreadBuffer& threadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = []() {
+        auto created = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        created->threadIndex = (int) registry.size();
+        registry.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+}
+
+std::atomic<bool> Profiler::_enabled(false);
+
+void Profiler::setEnabled(bool enabled) {
+    _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::record(Stage stage, int64_t start, int64_t end) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.totalTime[(size_t) stage] += end - start;
+    buffer.calls[(size_t) stage] += 1;
+    buffer.push({nullptr, stage, start, end});
+}
+
+void Profiler::counter(const char* name, int64_t value) {
+    if (!isEnabled()) {
+        return;
+    }
+
+    int64_t timestamp = now();
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    auto it = std::find_if(buffer.counters.begin(), buffer.counters.end(), [name](const CounterStats& c) {
+        return c.name == name;
+    });
+    if (it == buffer.counters.end()) {
+        buffer.counters.push_back({name});
+        it = buffer.counters.end() - 1;
+    }
+    it->max = std::max(it->max, value);
+    it->sum += value;
+    it->samples += 1;
+    buffer.push({name, Stage::Count, timestamp, value});
+}
+
+void Profiler::printSummary(std::ostream& out, int frameCount, double wallSeconds) {
+    std::array<int64_t, STAGE_COUNT> totalTime = {};
+    std::array<int64_t, STAGE_COUNT> calls = {};
+    std::vector<CounterStats> counters;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& buffer : registry) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            for (size_t i = 0; i < STAGE_COUNT; i++) {
+                totalTime[i] += buffer->totalTime[i];
+                calls[i] += buffer->calls[i];
+            }
+            for (const auto& c : buffer->counters) {
+                auto it = std::find_if(counters.begin(), counters.end(), [&c](const CounterStats& o) {
+                    return o.name == c.name;
+                });
+                if (it == counters.end()) {
+                    counters.push_back(c);
+                } else {
+                    it->max = std::max(it->max, c.max);
+                    it->sum += c.sum;
+                    it->samples += c.samples;
+                }
+            }
+        }
+    }
+
+    int64_t allStagesTime = 0;
+    for (int64_t t : totalTime) {
+        allStagesTime += t;
+    }
+
+    // formatted separately, so that flags and precision of caller's stream are untouched
+    std::ostringstream text;
+    text << "*** Processed " << frameCount << " frames in " << std::fixed << std::setprecision(2) << wallSeconds
+        << " s (" << (wallSeconds > 0.0 ? frameCount / wallSeconds : 0.0) << " fps)" << std::endl;
+    text << "*** " << std::left << std::setw(8) << "stage" << std::right
+        << std::setw(10) << "calls" << std::setw(12) << "mean ms"
+        << std::setw(12) << "fps" << std::setw(10) << "share" << std::endl;
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        if (calls[i] == 0) {
+            continue;
+        }
+        double seconds = totalTime[i] / 1e9;
+        text << "*** " << std::left << std::setw(8) << stageName((Stage) i) << std::right
+            << std::setw(10) << calls[i]
+            << std::setw(12) << seconds * 1e3 / calls[i]
+            << std::setw(12) << (seconds > 0.0 ? calls[i] / seconds : 0.0)
+            << std::setw(9) << (allStagesTime > 0 ? 100.0 * totalTime[i] / allStagesTime : 0.0) << "%"
+            << std::endl;
+    }
+    for (const auto& c : counters) {
+        text << "*** " << c.name << ": max " << c.max << ", mean " << (double) c.sum / c.samples << std::endl;
+    }
+    out << text.str();
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // timestamps in microseconds, with nanosecond digits (default precision loses them after a second)
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::vector<Event> events;
+    for (const auto& buffer : registry) {
+        // events are copied, so that recording thread is not blocked while file is written
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            size_t count = std::min(buffer->written, RING_CAPACITY);
+            events.clear();
+            for (size_t i = buffer->written - count; i < buffer->written; i++) {
+                events.push_back(buffer->ring[i % RING_CAPACITY]);
+            }
+        }
+        for (const Event& e : events) {
+            file << (first ? "\n" : ",\n");
+            first = false;
+            if (e.counterName == nullptr) {
+                file << "{\"name\":\"" << stageName(e.stage) << "\",\"cat\":\"stage\",\"ph\":\"X\""
+                     << ",\"ts\":" << e.start / 1000.0 << ",\"dur\":" << (e.value - e.start) / 1000.0
+                     << ",\"pid\":1,\"tid\":" << buffer->threadIndex << "}";
+            } else {
+                file << "{\"name\":\"" << e.counterName << "\",\"ph\":\"C\""
+                     << ",\"ts\":" << e.start / 1000.0
+                     << ",\"pid\":1,\"args\":{\"value\":" << e.value << "}}";
+            }
+        }
+    }
+    file << "\n]}" << std::endl;
+
+    return file.good();
+}
+
+} // namespace avo
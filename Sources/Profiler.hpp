@@ -0,0 +1,87 @@
+#ifndef SCREENFRAMER_PROFILER_HPP
+#define SCREENFRAMER_PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace avo {
+
+// Processing stages measured by profiler
+enum class Stage: uint8_t {
+    Decode,
+    Upload,
+    Resize,
+    Blend,
+    Pack,
+    Encode,
+    Count
+};
+
+const char* stageName(Stage stage);
+
+/**
+ * Process-wide, low-overhead stage profiler.
+ * Every thread records into its own ring buffer (recent events, for traces)
+ * and aggregate counters (all events, for summary), so recording takes only uncontended lock of its buffer.
+ * When disabled, timers cost single relaxed atomic load.
+ * Summary and trace may be produced while other threads record, they include events recorded so far.
+ */
+class Profiler {
+private:
+    static std::atomic<bool> _enabled;
+public:
+    static void setEnabled(bool enabled);
+    static inline bool isEnabled() {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    // nanoseconds since profiler epoch
+    static int64_t now();
+    static void record(Stage stage, int64_t start, int64_t end);
+    // samples named value (e.g. queue depth), name must have static storage duration
+    static void counter(const char* name, int64_t value);
+
+    /**
+     * Prints per-stage summary: call count, mean time, throughput and share of total stage time
+     * @param out output stream
+     * @param frameCount number of processed frames
+     * @param wallSeconds wall-clock duration of processing
+     */
+    static void printSummary(std::ostream& out, int frameCount, double wallSeconds);
+    // writes recorded events in Chrome trace event format (chrome://tracing, Perfetto)
+    static bool writeChromeTrace(const std::string& path);
+};
+
+// Records duration of enclosing scope as given stage
+class ScopedTimer {
+private:
+    Stage _stage;
+    bool _active;
+    int64_t _start = 0;
+public:
+    explicit ScopedTimer(Stage stage): _stage(stage), _active(Profiler::isEnabled()) {
+        if (_active) {
+            _start = Profiler::now();
+        }
+    }
+
+    ~ScopedTimer() {
+        if (_active) {
+            Profiler::record(_stage, _start, Profiler::now());
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+} // namespace avo
+
+#define SF_PROFILE_CONCAT_(a, b) a##b
+#define SF_PROFILE_CONCAT(a, b) SF_PROFILE_CONCAT_(a, b)
+#define SF_PROFILE_STAGE(stage) avo::ScopedTimer SF_PROFILE_CONCAT(sfProfileTimer, __LINE__)(stage)
+
+#endif //SCREENFRAMER_PROFILER_HPP
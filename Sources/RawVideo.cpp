@@ -0,0 +1,159 @@
+#include "RawVideo.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace avo {
+
+static std::string lowercaseExtension(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext;
+}
+
+bool isRawVideoPath(const std::string& path) {
+    return lowercaseExtension(path) == ".y4m" || isHeaderlessRawVideoPath(path);
+}
+
+bool isHeaderlessRawVideoPath(const std::string& path) {
+    std::string ext = lowercaseExtension(path);
+    return ext == ".yuv" || ext == ".bgr";
+}
+
+RawPixelFormat rawPixelFormatOf(const std::string& path) {
+    return lowercaseExtension(path) == ".bgr" ? RawPixelFormat::BGR24 : RawPixelFormat::I420;
+}
+
+// MappedVideo
+
+MappedVideo::MappedVideo(const std::string& path) {
+    map(path);
+    parseY4M(path);
+}
+
+MappedVideo::MappedVideo(const std::string& path, const RawVideoFormat& format): _format(format) {
+    if (!format.isValid()) {
+        throw std::invalid_argument("Invalid raw video format (I420 requires even dimensions)");
+    }
+    map(path);
+    size_t frameBytes = format.frameBytes();
+    for (size_t offset = 0; offset + frameBytes <= _size; offset += frameBytes) {
+        _frameOffsets.push_back(offset);
+    }
+}
+
+MappedVideo::~MappedVideo() {
+    if (_data != nullptr) {
+        munmap(_data, _size);
+    }
+}
+
+void MappedVideo::map(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open input video: " + path);
+    }
+    struct stat info = {};
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        throw std::runtime_error("Input video is empty: " + path);
+    }
+    _size = (size_t) info.st_size;
+    void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // mapping stays valid after descriptor is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Unable to map input video: " + path);
+    }
+    _data = data;
+    // frames are read once, front to back
+    madvise(_data, _size, MADV_SEQUENTIAL);
+}
+
+void MappedVideo::parseY4M(const std::string& path) {
+    const char* bytes = (const char*) _data;
+    const char* headerEnd = (const char*) std::memchr(bytes, '\n', _size);
+    if (_size < 10 || std::memcmp(bytes, "YUV4MPEG2 ", 10) != 0 || headerEnd == nullptr) {
+        throw std::invalid_argument("Not a Y4M file: " + path);
+    }
+
+    std::istringstream header(std::string(bytes + 10, headerEnd));
+    std::string token;
+    std::string colorspace = "420";
+    int rateNum = 0, rateDen = 1;
+    while (header >> token) {
+        switch (token[0]) {
+            case 'W': _format.width = std::atoi(token.c_str() + 1); break;
+            case 'H': _format.height = std::atoi(token.c_str() + 1); break;
+            case 'F': std::sscanf(token.c_str() + 1, "%d:%d", &rateNum, &rateDen); break;
+            case 'C': colorspace = token.substr(1); break;
+            // interlacing, aspect ratio and extensions do not affect frame layout
+            default: break;
+        }
+    }
+    // 8-bit 4:2:0 variants differ only in chroma siting, deeper ones (e.g. C420p10) have 16-bit samples
+    if (colorspace.compare(0, 4, "420p") == 0) {
+        throw std::invalid_argument("Unsupported Y4M colorspace C" + colorspace + ", only 8-bit 4:2:0 is supported");
+    }
+    if (colorspace != "420" && colorspace != "420jpeg" && colorspace != "420paldv" && colorspace != "420mpeg2") {
+        throw std::invalid_argument("Unsupported Y4M colorspace C" + colorspace + ", only 4:2:0 is supported");
+    }
+    _format.fps = rateDen > 0 ? (double) rateNum / rateDen : 0.0;
+    _format.pixelFormat = RawPixelFormat::I420;
+    if (!_format.isValid()) {
+        throw std::invalid_argument("Invalid Y4M header: " + path);
+    }
+
+    // every frame starts with FRAME line (possibly with parameters), truncated last frame is dropped
+    size_t frameBytes = _format.frameBytes();
+    size_t offset = headerEnd - bytes + 1;
+    while (offset + 5 <= _size && std::memcmp(bytes + offset, "FRAME", 5) == 0) {
+        const char* lineEnd = (const char*) std::memchr(bytes + offset, '\n', _size - offset);
+        if (lineEnd == nullptr) {
+            break;
+        }
+        size_t dataOffset = lineEnd - bytes + 1;
+        if (dataOffset + frameBytes > _size) {
+            break;
+        }
+        _frameOffsets.push_back(dataOffset);
+        offset = dataOffset + frameBytes;
+    }
+}
+
+const RawVideoFormat& MappedVideo::format() const {
+    return _format;
+}
+
+int MappedVideo::frameCount() const {
+    return (int) _frameOffsets.size();
+}
+
+cv::Mat MappedVideo::frameView(int index) const {
+    // mapping is read-only, views are never written to
+    auto* data = (uint8_t*) _data + _frameOffsets.at(index);
+    if (_format.pixelFormat == RawPixelFormat::I420) {
+        return cv::Mat(_format.height * 3 / 2, _format.width, CV_8UC1, data);
+    }
+    return cv::Mat(_format.height, _format.width, CV_8UC3, data);
+}
+
+cv::Mat& MappedVideo::readFrame(int index, cv::Mat& bgr) const {
+    if (_format.pixelFormat == RawPixelFormat::BGR24) {
+        bgr = frameView(index);
+    } else {
+        cv::cvtColor(frameView(index), bgr, cv::COLOR_YUV2BGR_I420);
+    }
+    return bgr;
+}
+
+} // namespace avo
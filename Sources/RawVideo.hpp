@@ -0,0 +1,60 @@
+#ifndef SCREENFRAMER_RAWVIDEO_HPP
+#define SCREENFRAMER_RAWVIDEO_HPP
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+#include "OutputConfig.hpp"
+
+namespace avo {
+
+// returns true if path has extension of Y4M (.y4m) or headerless raw video (.yuv - I420, .bgr - BGR24)
+bool isRawVideoPath(const std::string& path);
+
+// returns true if path has extension of headerless raw video, whose geometry has to be given explicitly
+bool isHeaderlessRawVideoPath(const std::string& path);
+
+// pixel format of headerless raw video, selected by extension
+RawPixelFormat rawPixelFormatOf(const std::string& path);
+
+/**
+ * Memory-mapped Y4M (4:2:0) or headerless raw video.
+ * Frames are accessed as views into mapped file, so they are read without copying.
+ */
+class MappedVideo {
+private:
+    void* _data = nullptr;
+    size_t _size = 0;
+    RawVideoFormat _format;
+    // offsets of frame data in file
+    std::vector<size_t> _frameOffsets;
+public:
+    // opens Y4M file, format is read from its header
+    explicit MappedVideo(const std::string& path);
+    // opens headerless raw video of given format
+    MappedVideo(const std::string& path, const RawVideoFormat& format);
+    ~MappedVideo();
+    MappedVideo(const MappedVideo&) = delete;
+    MappedVideo& operator=(const MappedVideo&) = delete;
+
+    const RawVideoFormat& format() const;
+    int frameCount() const;
+    /**
+     * Read-only view of frame in mapped memory
+     * @return CV_8UC3 for BGR24, CV_8UC1 with height * 3 / 2 rows for I420
+     */
+    cv::Mat frameView(int index) const;
+    /**
+     * Frame as bgr: BGR24 frames are returned as views (without copying), I420 frames are converted
+     * @param bgr buffer for converted frames
+     * @return bgr frame, valid until next call or destruction of video
+     */
+    cv::Mat& readFrame(int index, cv::Mat& bgr) const;
+private:
+    void map(const std::string& path);
+    void parseY4M(const std::string& path);
+};
+
+} // namespace avo
+
+#endif //SCREENFRAMER_RAWVIDEO_HPP
@@ -0,0 +1,193 @@
+#include "Remux.hpp"
+#include "LibavSupport.hpp"
+#include "Debug.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace avo {
+
+#ifdef SF_WITH_LIBAV
+
+static InputContext openInput(const std::string& path, int& videoStreamIndex) {
+    InputContext ctx = openMediaInput(path, AVMEDIA_TYPE_VIDEO, videoStreamIndex);
+    checkAV(videoStreamIndex, "No video stream in " + path);
+
+    return ctx;
+}
+
+bool hasRemuxSupport() {
+    return true;
+}
+
+std::vector<Keyframe> probeKeyframes(const std::string& path, int& frameCount) {
+    int videoIndex;
+    InputContext ctx = openInput(path, videoIndex);
+    AVStream* stream = ctx->streams[videoIndex];
+    Packet pkt(av_packet_alloc());
+    // packets come in decode order, which differs from presentation order with B-frames
+    std::vector<int64_t> timestamps;
+    std::vector<int64_t> keyTimestamps;
+    while (av_read_frame(ctx.get(), pkt.get()) >= 0) {
+        if (pkt->stream_index == videoIndex) {
+            int64_t timestamp = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            timestamps.push_back(timestamp);
+            if (pkt->flags & AV_PKT_FLAG_KEY) {
+                keyTimestamps.push_back(timestamp);
+            }
+        }
+        av_packet_unref(pkt.get());
+    }
+    std::sort(timestamps.begin(), timestamps.end());
+    std::sort(keyTimestamps.begin(), keyTimestamps.end());
+    frameCount = (int) timestamps.size();
+
+    // the same origin as OpenCV uses for frame positions
+    int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    std::vector<Keyframe> keyframes;
+    for (int64_t timestamp : keyTimestamps) {
+        auto rank = std::lower_bound(timestamps.begin(), timestamps.end(), timestamp) - timestamps.begin();
+        double timestampMs = (double) (timestamp - start) * av_q2d(stream->time_base) * 1000.0;
+        keyframes.push_back({(int) rank, timestampMs});
+    }
+    DEBUG_PRINTLN("*** Probed " << keyframes.size() << " keyframes in " << frameCount << " packets");
+
+    return keyframes;
+}
+
+// stream parameters, which are written once into output header
+static bool sameVideoParameters(const AVCodecParameters* a, const AVCodecParameters* b) {
+    return a->codec_id == b->codec_id && a->width == b->width && a->height == b->height && a->format == b->format
+        && a->extradata_size == b->extradata_size
+        && (a->extradata_size == 0 || std::memcmp(a->extradata, b->extradata, a->extradata_size) == 0);
+}
+
+bool haveSameVideoParameters(const std::vector<std::string>& paths) {
+    if (paths.empty()) {
+        return true;
+    }
+    int firstIndex;
+    InputContext first = openInput(paths.front(), firstIndex);
+    for (size_t i = 1; i < paths.size(); i++) {
+        int videoIndex;
+        InputContext input = openInput(paths[i], videoIndex);
+        if (!sameVideoParameters(first->streams[firstIndex]->codecpar, input->streams[videoIndex]->codecpar)) {
+            DEBUG_PRINTLN("*** Codec parameters of " << paths[i] << " differ from " << paths.front());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool hasAudioStream(const std::string& path) {
+    int audioIndex;
+    InputContext ctx = openMediaInput(path, AVMEDIA_TYPE_AUDIO, audioIndex);
+    return audioIndex >= 0;
+}
+
+void concatenateVideos(
+    const std::vector<std::string>& inputPaths,
+    const std::string& outputPath,
+    const std::string& audioSourcePath
+) {
+    if (inputPaths.empty()) {
+        throw std::invalid_argument("No input files to concatenate");
+    }
+
+    OutputContext output = openMediaOutput(outputPath);
+    AVStream* outStream = nullptr;
+    AudioPassthrough audio;
+    Packet pkt(av_packet_alloc());
+    // timestamps of the last written packet, in output time base
+    int64_t lastPtsEnd = 0;
+    int64_t lastDts = AV_NOPTS_VALUE;
+    for (const auto& path : inputPaths) {
+        int videoIndex;
+        InputContext input = openInput(path, videoIndex);
+        AVStream* inStream = input->streams[videoIndex];
+        if (outStream != nullptr && !sameVideoParameters(outStream->codecpar, inStream->codecpar)) {
+            throw std::runtime_error("Codec parameters of " + path + " differ from the first part");
+        }
+        if (outStream == nullptr) {
+            // stream parameters (including extradata) are taken from the first part
+            outStream = avformat_new_stream(output.get(), nullptr);
+            if (outStream == nullptr) {
+                throw std::runtime_error("Unable to create output stream");
+            }
+            checkAV(avcodec_parameters_copy(outStream->codecpar, inStream->codecpar), "Unable to copy codec parameters");
+            outStream->codecpar->codec_tag = 0;
+            outStream->time_base = inStream->time_base;
+            if (!audioSourcePath.empty()) {
+                audio.open(audioSourcePath, output.get());
+            }
+            checkAV(avformat_write_header(output.get(), nullptr), "Unable to write header of " + outputPath);
+        }
+
+        // shift part timestamps, so that presentation continues where last part ended
+        // and decoding timestamps stay strictly monotonic
+        bool first = true;
+        int64_t shift = 0;
+        while (av_read_frame(input.get(), pkt.get()) >= 0) {
+            if (pkt->stream_index != videoIndex) {
+                av_packet_unref(pkt.get());
+                continue;
+            }
+
+            av_packet_rescale_ts(pkt.get(), inStream->time_base, outStream->time_base);
+            if (first) {
+                int64_t firstPts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+                int64_t firstDts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : firstPts;
+                shift = lastPtsEnd - firstPts;
+                if (lastDts != AV_NOPTS_VALUE) {
+                    shift = std::max(shift, lastDts + 1 - firstDts);
+                }
+                first = false;
+            }
+            if (pkt->pts != AV_NOPTS_VALUE) {
+                pkt->pts += shift;
+                lastPtsEnd = std::max(lastPtsEnd, pkt->pts + pkt->duration);
+            }
+            if (pkt->dts != AV_NOPTS_VALUE) {
+                pkt->dts += shift;
+                lastDts = pkt->dts;
+            }
+            pkt->stream_index = outStream->index;
+            pkt->pos = -1;
+            // audio preceding this packet goes first, so that streams are interleaved by time
+            audio.writeUntil(output.get(), pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts, outStream->time_base);
+            // takes ownership of packet data
+            checkAV(av_interleaved_write_frame(output.get(), pkt.get()), "Unable to write packet to " + outputPath);
+        }
+        DEBUG_PRINTLN("*** Concatenated " << path << ", shift: " << shift);
+    }
+
+    audio.finish(output.get());
+    checkAV(av_write_trailer(output.get()), "Unable to finalize " + outputPath);
+}
+
+#else
+
+bool hasRemuxSupport() {
+    return false;
+}
+
+std::vector<Keyframe> probeKeyframes(const std::string&, int&) {
+    throw std::runtime_error("screenframer was built without libav support");
+}
+
+bool haveSameVideoParameters(const std::vector<std::string>&) {
+    return false;
+}
+
+bool hasAudioStream(const std::string&) {
+    return false;
+}
+
+void concatenateVideos(const std::vector<std::string>&, const std::string&, const std::string&) {
+    throw std::runtime_error("screenframer was built without libav support");
+}
+
+#endif
+
+} // namespace avo
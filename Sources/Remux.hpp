@@ -0,0 +1,60 @@
+#ifndef SCREENFRAMER_REMUX_HPP
+#define SCREENFRAMER_REMUX_HPP
+
+#include <string>
+#include <vector>
+
+namespace avo {
+
+/**
+ * Returns true if screenframer was built with libav (FFmpeg) support,
+ * which is required for stream-level operations below.
+ */
+bool hasRemuxSupport();
+
+// Key frame of video stream, in presentation order
+struct Keyframe {
+    // index of frame in presentation order
+    int frameIndex;
+    // presentation timestamp relative to stream start, as reported by cv::CAP_PROP_POS_MSEC
+    double timestampMs;
+};
+
+/**
+ * Lists key frames in the first video stream of a file.
+ * Only packet headers are read, no frames are decoded. Frames are ordered by presentation
+ * timestamps, so that indices are valid also for streams with B-frames and open GOPs.
+ * @param path path of the video file
+ * @param frameCount number of video packets (frames) in the stream
+ * @return key frames ordered by frameIndex
+ */
+std::vector<Keyframe> probeKeyframes(const std::string& path, int& frameCount);
+
+/**
+ * Returns true if video streams of given files have the same codec parameters
+ * (codec, dimensions, pixel format and extradata), so that they can be concatenated.
+ * @param paths paths of the parts
+ */
+bool haveSameVideoParameters(const std::vector<std::string>& paths);
+
+// Returns true if file contains audio stream (false without libav support)
+bool hasAudioStream(const std::string& path);
+
+/**
+ * Concatenates video streams of given files into single output file
+ * without re-encoding. All inputs must share codec parameters
+ * (they are expected to come from the same encoder configuration).
+ * @param inputPaths paths of the parts, in presentation order
+ * @param outputPath path of the output file
+ * @param audioSourcePath file, whose audio is copied (without re-encoding) into output, empty - no audio
+ * @throws std::runtime_error when codec parameters of a part differ from the first one
+ */
+void concatenateVideos(
+    const std::vector<std::string>& inputPaths,
+    const std::string& outputPath,
+    const std::string& audioSourcePath = ""
+);
+
+} // namespace avo
+
+#endif //SCREENFRAMER_REMUX_HPP
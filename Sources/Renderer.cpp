@@ -0,0 +1,885 @@
+#include "Renderer.hpp"
+#include "Remux.hpp"
+#include "FrameWriter.hpp"
+#include "FramePool.hpp"
+#include "Compositor.hpp"
+#include "RawVideo.hpp"
+#include "DeepVideo.hpp"
+#include "Placement.hpp"
+#include "Background.hpp"
+#include "Profiler.hpp"
+#include "Debug.hpp"
+#include <opencv2/core/ocl.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+#include <opencv2/videoio/registry.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && (CV_VERSION_MINOR > 5 || (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 1)))
+#define SF_HAVE_CV_ORIENTATION
+#endif
+
+namespace avo {
+
+int Segment::length() const {
+    return endFrame - firstFrame;
+}
+
+std::vector<Segment> planSegments(const std::vector<Keyframe>& keyframes, int totalFrames, int count) {
+    if (totalFrames <= 0 || count <= 0) {
+        throw std::invalid_argument("Frame count and segment count must be positive");
+    }
+
+    // pick key frame closest to each evenly spaced boundary
+    auto isBefore = [](const Keyframe& keyframe, int index) { return keyframe.frameIndex < index; };
+    std::vector<Keyframe> boundaries;
+    for (int i = 1; i < count; i++) {
+        int target = (int) ((long long) totalFrames * i / count);
+        auto it = std::lower_bound(keyframes.begin(), keyframes.end(), target, isBefore);
+        const Keyframe* candidate = nullptr;
+        if (it != keyframes.end()) {
+            candidate = &*it;
+        }
+        if (it != keyframes.begin() && (candidate == nullptr || target - (it - 1)->frameIndex < candidate->frameIndex - target)) {
+            candidate = &*(it - 1);
+        }
+        int previous = boundaries.empty() ? 0 : boundaries.back().frameIndex;
+        if (candidate != nullptr && candidate->frameIndex > previous && candidate->frameIndex < totalFrames) {
+            boundaries.push_back(*candidate);
+        }
+    }
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    std::vector<Segment> segments;
+    Segment segment = {0, 0, -infinity, infinity};
+    for (const Keyframe& boundary : boundaries) {
+        segment.endFrame = boundary.frameIndex;
+        segment.endMs = boundary.timestampMs;
+        segments.push_back(segment);
+        segment = {boundary.frameIndex, 0, boundary.timestampMs, infinity};
+    }
+    segment.endFrame = totalFrames;
+    segments.push_back(segment);
+
+    return segments;
+}
+
+// decoded frames are always on host, device tasks get them with single upload
+static cv::Mat& uploadFrame(cv::Mat& frame, cv::Mat&) {
+    return frame;
+}
+
+static cv::UMat& uploadFrame(cv::Mat& frame, cv::UMat& deviceFrame) {
+    SF_PROFILE_STAGE(Stage::Upload);
+    frame.copyTo(deviceFrame);
+    return deviceFrame;
+}
+
+// OpenCL usage is thread-local, so workers spawned by render functions take it over from calling thread
+template<class Function>
+static auto withCallerOpenCL(Function function) {
+    bool useOpenCL = cv::ocl::useOpenCL();
+    return [function = std::move(function), useOpenCL]() mutable {
+        cv::ocl::setUseOpenCL(useOpenCL);
+        return function();
+    };
+}
+
+int probeFrameRotation(const std::string& inputPath) {
+#ifdef SF_HAVE_CV_ORIENTATION
+    cv::VideoCapture cap(inputPath);
+    if (!cap.isOpened()) {
+        return 0;
+    }
+    // metadata may contain arbitrary angle, frames are rotated only by multiples of 90 degrees
+    int degrees = (int) std::lround(cap.get(cv::CAP_PROP_ORIENTATION_META) / 90.0) * 90;
+    return normalizeRotation(degrees);
+#else
+    return 0;
+#endif
+}
+
+// opens input video, decoder's rotation is disabled when task rotates frames itself
+static void openInput(cv::VideoCapture& cap, const std::string& inputPath, const OutputConfig& outputConfig) {
+    // decoder threads are started while opening
+    ScopedPlacement placement(Stage::Decode);
+    if (!cap.open(inputPath)) {
+        throw std::runtime_error("Unable to open input video: " + inputPath);
+    }
+#ifdef SF_HAVE_CV_ORIENTATION
+    if (outputConfig.frameRotation != 0) {
+        cap.set(cv::CAP_PROP_ORIENTATION_AUTO, 0);
+    }
+#else
+    (void) outputConfig;
+#endif
+}
+
+// decodes next frame, returns false at the end of video
+static bool decodeFrame(cv::VideoCapture& cap, cv::Mat& frame) {
+    SF_PROFILE_STAGE(Stage::Decode);
+    return cap.read(frame);
+}
+
+// decoding at reduced resolution pays off only when most of decoded pixels would be discarded
+static constexpr double DECODE_SCALE_MIN_AREA_RATIO = 2.0;
+
+static bool shouldScaleAtDecode(cv::Size inputSize, cv::Size screenSize) {
+    return inputSize.area() >= DECODE_SCALE_MIN_AREA_RATIO * screenSize.area() && !screenSize.empty();
+}
+
+/**
+ * Opens capture, which scales frames to given size in decoder's native (YUV) format,
+ * before conversion to BGR (GStreamer videoscale)
+ * @return false if GStreamer backend is unavailable or pipeline can't be created
+ */
+static bool openScaledCapture(cv::VideoCapture& cap, const std::string& inputPath, cv::Size size, ScaleFilter filter) {
+    if (!cv::videoio_registry::hasBackend(cv::CAP_GSTREAMER)) {
+        return false;
+    }
+
+    std::string location;
+    for (char c : inputPath) {
+        if (c == '"' || c == '\\') {
+            location += '\\';
+        }
+        location += c;
+    }
+    // videoscale method closest to scale filter of task
+    // (multi-tap bilinear filters all source pixels when downscaling, similarly to area)
+    const char* method = filter == ScaleFilter::Lanczos ? "lanczos" : filter == ScaleFilter::Area ? "bilinear2" : "bilinear";
+    std::string pipeline = "filesrc location=\"" + location + "\" ! decodebin"
+        " ! videoscale method=" + method +
+        " ! video/x-raw,width=" + std::to_string(size.width) + ",height=" + std::to_string(size.height) +
+        ",pixel-aspect-ratio=1/1 ! videoconvert ! video/x-raw,format=BGR ! appsink sync=false";
+    DEBUG_PRINTLN("*** Scaled decoder pipeline: " << pipeline);
+
+    ScopedPlacement placement(Stage::Decode);
+    return cap.open(pipeline, cv::CAP_GSTREAMER);
+}
+
+// maps Y4M or headerless raw input, geometry of the latter is given by output config
+static std::unique_ptr<MappedVideo> openMappedVideo(const std::string& inputPath, const OutputConfig& outputConfig) {
+    return isHeaderlessRawVideoPath(inputPath)
+        ? std::make_unique<MappedVideo>(inputPath, outputConfig.rawInputFormat)
+        : std::make_unique<MappedVideo>(inputPath);
+}
+
+// renders Y4M or headerless raw input, whose frames are read straight from mapped file
+template<class MatType>
+static RenderStats renderMappedVideo(
+    Overlayer& overlayer,
+    const std::string& inputPath,
+    const OutputConfig& outputConfig,
+    const ProgressCallback& progress
+) {
+    std::unique_ptr<MappedVideo> video = openMappedVideo(inputPath, outputConfig);
+    int totalFrames = video->frameCount();
+
+    auto task = overlayer.overlayTask<MatType>(outputConfig);
+    task.initialize();
+
+    // bgr frames are views into mapped file, others are converted into pooled buffer
+    cv::Mat converted;
+    usePool(converted);
+    MatType taskFrame;
+    for (int index = 0; index < totalFrames; index++) {
+        cv::Mat* frame;
+        {
+            SF_PROFILE_STAGE(Stage::Decode);
+            frame = &video->readFrame(index, converted);
+        }
+        task.feedFrame(uploadFrame(*frame, taskFrame));
+        if (progress) {
+            progress(index, totalFrames);
+        }
+    }
+    task.finalize();
+
+    RenderStats stats;
+    stats.frameCount = totalFrames;
+    stats.taskAllocatedBytes = task.allocatedBytes() + task.sharedBytes();
+    return stats;
+}
+
+// renders input decoded with libav into 16-bit frames, which are passed to 10-bit encoder
+template<class MatType>
+static RenderStats renderDeepVideo(
+    Overlayer& overlayer,
+    const std::string& inputPath,
+    const OutputConfig& outputConfig,
+    const ProgressCallback& progress
+) {
+    DeepVideoReader reader;
+    reader.open(inputPath);
+    int totalFrames = reader.frameCount();
+
+    auto task = overlayer.overlayTask<MatType>(outputConfig);
+    task.initialize();
+
+    cv::Mat frame;
+    usePool(frame);
+    MatType taskFrame;
+    int index = 0;
+    while (true) {
+        {
+            SF_PROFILE_STAGE(Stage::Decode);
+            if (!reader.read(frame)) {
+                break;
+            }
+        }
+        task.feedFrame(uploadFrame(frame, taskFrame));
+        if (progress) {
+            progress(index, totalFrames);
+        }
+        index += 1;
+    }
+    task.finalize();
+
+    RenderStats stats;
+    stats.frameCount = index;
+    stats.taskAllocatedBytes = task.allocatedBytes() + task.sharedBytes();
+    return stats;
+}
+
+template<class MatType>
+RenderStats renderVideo(
+    Overlayer& overlayer,
+    const std::string& inputPath,
+    const OutputConfig& outputConfig,
+    const ProgressCallback& progress
+) {
+    if (isRawVideoPath(inputPath)) {
+        return renderMappedVideo<MatType>(overlayer, inputPath, outputConfig, progress);
+    } else if (outputConfig.deepColor) {
+        return renderDeepVideo<MatType>(overlayer, inputPath, outputConfig, progress);
+    }
+
+    cv::VideoCapture cap;
+    openInput(cap, inputPath, outputConfig);
+    int totalFrames = (int) cap.get(cv::CAP_PROP_FRAME_COUNT);
+    cv::Size inputSize((int) cap.get(cv::CAP_PROP_FRAME_WIDTH), (int) cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+
+    auto task = overlayer.overlayTask<MatType>(outputConfig);
+    task.initialize();
+
+    // small outputs (opt-in): decoder produces frames at screen size, so that task does not resize them
+    // (segments are not decoded this way, as seeking in scaling pipeline is not frame-accurate,
+    // neither are rotated frames, as pipeline does not rotate them)
+    bool scaleAtDecode = outputConfig.scaleAtDecode && outputConfig.frameRotation == 0;
+    if (scaleAtDecode && shouldScaleAtDecode(inputSize, task.screenSize())) {
+        cap.release();
+        if (openScaledCapture(cap, inputPath, task.screenSize(), outputConfig.scaleFilter)) {
+            DEBUG_PRINTLN("*** Decoding at screen size: [" << task.screenSize().width << ", " << task.screenSize().height << "]");
+            // pipeline may report frame count differently, keep probed one if it does not know it
+            int scaledFrames = (int) cap.get(cv::CAP_PROP_FRAME_COUNT);
+            if (scaledFrames > 0) {
+                totalFrames = scaledFrames;
+            }
+        } else {
+            openInput(cap, inputPath, outputConfig);
+        }
+    }
+
+    // decoder writes into the same pooled buffer every frame
+    cv::Mat frame;
+    usePool(frame);
+    MatType taskFrame;
+    int index = 0;
+    while (cap.isOpened()) {
+        if (!decodeFrame(cap, frame)) {
+            break;
+        }
+
+        task.feedFrame(uploadFrame(frame, taskFrame));
+        if (progress) {
+            progress(index, totalFrames);
+        }
+        index += 1;
+    }
+    cap.release();
+    task.finalize();
+
+    RenderStats stats;
+    stats.frameCount = index;
+    stats.taskAllocatedBytes = task.allocatedBytes() + task.sharedBytes();
+    return stats;
+}
+
+static constexpr double SEGMENT_BOUNDARY_TOLERANCE_MS = 0.5;
+
+// memory used by task of single segment
+struct SegmentMemory {
+    size_t taskBytes;
+    // template assets, shared by all segments
+    size_t sharedBytes;
+};
+
+// renders frames of single segment into separate file, returns task memory usage
+template<class MatType>
+static SegmentMemory renderSegment(
+    Overlayer& overlayer,
+    const std::string& inputPath,
+    const OutputConfig& outputConfig,
+    const Segment& segment,
+    std::atomic<int>& processedFrames
+) {
+    cv::VideoCapture cap;
+    openInput(cap, inputPath, outputConfig);
+    // segments start at key frames, so seeking there does not require decoding preceding frames
+    // (by timestamp, frame positions of OpenCV are estimated from frame rate)
+    if (std::isfinite(segment.startMs)) {
+        cap.set(cv::CAP_PROP_POS_MSEC, segment.startMs);
+    }
+
+    auto task = overlayer.overlayTask<MatType>(outputConfig);
+    task.initialize();
+
+    cv::Mat frame;
+    usePool(frame);
+    MatType taskFrame;
+    while (decodeFrame(cap, frame)) {
+        // frame at boundary belongs to the next segment, tolerance absorbs rounding of timestamps
+        double timestampMs = cap.get(cv::CAP_PROP_POS_MSEC);
+        if (timestampMs < segment.startMs - SEGMENT_BOUNDARY_TOLERANCE_MS) {
+            continue;
+        }
+        if (timestampMs >= segment.endMs - SEGMENT_BOUNDARY_TOLERANCE_MS) {
+            break;
+        }
+
+        task.feedFrame(uploadFrame(frame, taskFrame));
+        processedFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+    cap.release();
+    task.finalize();
+
+    return {task.allocatedBytes(), task.sharedBytes()};
+}
+
+template<class MatType>
+RenderStats renderVideoSegmented(
+    Overlayer& overlayer,
+    const std::string& inputPath,
+    const OutputConfig& outputConfig,
+    int segmentCount,
+    const ProgressCallback& progress
+) {
+    // parts are H.264 files, raw inputs are not split as they are not decoded anyway,
+    // neither is 10-bit video, as parts are encoded by 8-bit writer
+    if (segmentCount <= 1 || !hasRemuxSupport() || isAnimatedImagePath(outputConfig.path)
+        || isRawVideoPath(outputConfig.path) || isRawVideoPath(inputPath) || outputConfig.deepColor) {
+        DEBUG_PRINTLN("*** Segmented rendering unavailable, falling back to sequential");
+        return renderVideo<MatType>(overlayer, inputPath, outputConfig, progress);
+    }
+
+    // frame count from packets, container estimate is wrong for variable frame rate
+    int totalFrames = 0;
+    std::vector<Keyframe> keyframes = probeKeyframes(inputPath, totalFrames);
+    if (totalFrames <= 0 || keyframes.empty()) {
+        return renderVideo<MatType>(overlayer, inputPath, outputConfig, progress);
+    }
+
+    std::vector<Segment> segments = planSegments(keyframes, totalFrames, segmentCount);
+    DEBUG_PRINTLN("*** Rendering " << segments.size() << " segments");
+
+    // each segment is encoded next to the output, so that concatenation stays on one filesystem,
+    // in the same container format as output
+    std::string partExtension = std::filesystem::path(outputConfig.path).extension().string();
+    std::vector<std::string> partPaths;
+    std::vector<std::future<SegmentMemory>> workers;
+    std::atomic<int> processedFrames(0);
+    for (size_t i = 0; i < segments.size(); i++) {
+        OutputConfig partConfig = outputConfig;
+        partConfig.path = outputConfig.path + ".part" + std::to_string(i) + (partExtension.empty() ? ".mp4" : partExtension);
+        // audio is copied once, when parts are joined
+        partConfig.audioSourcePath.clear();
+        partPaths.push_back(partConfig.path);
+        workers.push_back(std::async(std::launch::async, withCallerOpenCL([&, partConfig, i]() {
+            return renderSegment<MatType>(overlayer, inputPath, partConfig, segments[i], processedFrames);
+        })));
+    }
+
+    // report progress until all workers are done
+    for (size_t i = 0; i < workers.size(); i++) {
+        while (workers[i].wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+            Profiler::counter("segments in flight", (int64_t) (workers.size() - i));
+            if (progress) {
+                progress(processedFrames.load(std::memory_order_relaxed), totalFrames);
+            }
+        }
+    }
+
+    auto removeParts = [&partPaths]() {
+        for (const auto& path : partPaths) {
+            std::remove(path.c_str());
+        }
+    };
+    RenderStats stats;
+    try {
+        size_t sharedBytes = 0;
+        for (auto& worker : workers) {
+            SegmentMemory memory = worker.get();
+            stats.taskAllocatedBytes += memory.taskBytes;
+            sharedBytes = std::max(sharedBytes, memory.sharedBytes);
+        }
+        stats.taskAllocatedBytes += sharedBytes;
+        // output takes stream header of the first part, so parts encoded differently can't be joined
+        if (!haveSameVideoParameters(partPaths)) {
+            DEBUG_PRINTLN("*** Segments were encoded with different parameters, falling back to sequential");
+            removeParts();
+            return renderVideo<MatType>(overlayer, inputPath, outputConfig, progress);
+        }
+        concatenateVideos(partPaths, outputConfig.path, outputConfig.audioSourcePath);
+    } catch (...) {
+        removeParts();
+        throw;
+    }
+    removeParts();
+    stats.frameCount = processedFrames.load();
+
+    return stats;
+}
+
+// decodes still image as BGR
+static void decodeImage(const std::string& path, cv::Mat& frame) {
+    SF_PROFILE_STAGE(Stage::Decode);
+    frame = cv::imread(path, cv::IMREAD_COLOR);
+    if (frame.empty()) {
+        throw std::runtime_error("Unable to read image " + path);
+    }
+}
+
+// renders every step-th image starting at first, returns task memory usage
+template<class MatType>
+static SegmentMemory renderImageShare(
+    Overlayer& overlayer,
+    const std::vector<ImageItem>& items,
+    size_t first,
+    size_t step,
+    const OutputConfig& outputConfig,
+    const std::vector<int>& writeParams,
+    std::atomic<int>& processedImages
+) {
+    std::vector<std::string> outputPaths;
+    for (size_t i = first; i < items.size(); i += step) {
+        outputPaths.push_back(items[i].outputPath);
+    }
+
+    auto task = overlayer.overlayTask<MatType>(outputConfig);
+    task.initialize(std::make_unique<ImageWriter>(std::move(outputPaths), writeParams));
+
+    cv::Mat frame;
+    MatType taskFrame;
+    for (size_t i = first; i < items.size(); i += step) {
+        decodeImage(items[i].inputPath, frame);
+        task.feedFrame(uploadFrame(frame, taskFrame));
+        processedImages.fetch_add(1, std::memory_order_relaxed);
+    }
+    task.finalize();
+
+    return {task.allocatedBytes(), task.sharedBytes()};
+}
+
+template<class MatType>
+RenderStats renderImages(
+    Overlayer& overlayer,
+    const std::vector<ImageItem>& items,
+    const OutputConfig& outputConfig,
+    int workerCount,
+    const std::vector<int>& writeParams,
+    const ProgressCallback& progress
+) {
+    RenderStats stats;
+    if (items.empty()) {
+        return stats;
+    }
+
+    // interleaved shares keep workers busy until the end, when image sizes vary along the list
+    size_t count = std::min(items.size(), (size_t) std::max(1, workerCount));
+    DEBUG_PRINTLN("*** Rendering " << items.size() << " images with " << count << " workers");
+    std::vector<std::future<SegmentMemory>> workers;
+    std::atomic<int> processedImages(0);
+    for (size_t i = 0; i < count; i++) {
+        workers.push_back(std::async(std::launch::async, withCallerOpenCL([&, i]() {
+            return renderImageShare<MatType>(overlayer, items, i, count, outputConfig, writeParams, processedImages);
+        })));
+    }
+
+    int totalImages = (int) items.size();
+    for (auto& worker : workers) {
+        while (worker.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+            if (progress) {
+                progress(processedImages.load(std::memory_order_relaxed), totalImages);
+            }
+        }
+    }
+
+    size_t sharedBytes = 0;
+    for (auto& worker : workers) {
+        SegmentMemory memory = worker.get();
+        stats.taskAllocatedBytes += memory.taskBytes;
+        sharedBytes = std::max(sharedBytes, memory.sharedBytes);
+    }
+    stats.taskAllocatedBytes += sharedBytes;
+    stats.frameCount = processedImages.load();
+
+    return stats;
+}
+
+// Scene
+
+namespace {
+
+// Draws slot output frames into shared scene canvas, over pixels covered by device only
+// (slots are rendered over their part of canvas background, so covered edges are already blended with it)
+class CanvasWriter: public FrameWriter {
+private:
+    cv::Mat& _canvas;
+    cv::Rect _rect;
+    Compositor<PixelFormat::BGR24, BlendPolicy::OpaqueCopy> _compositor;
+    bool _opened = false;
+public:
+    CanvasWriter(cv::Mat& canvas, cv::Point origin, const cv::Mat& coverage)
+        : _canvas(canvas), _rect(origin, coverage.size()), _compositor(coverage) {}
+
+    bool open(const std::string&, double, cv::Size size) override {
+        _opened = size == _rect.size() && (_rect & cv::Rect(0, 0, _canvas.cols, _canvas.rows)) == _rect;
+        return _opened;
+    }
+
+    void write(cv::InputArray frame) override {
+        _compositor.apply(_canvas(_rect), frame.getMat());
+    }
+
+    bool isOpened() const override {
+        return _opened;
+    }
+
+    void release() override {
+        _opened = false;
+    }
+
+    std::string backendName() const override {
+        return "Scene canvas";
+    }
+};
+
+// decoding state of single scene slot
+template<class MatType>
+struct SlotState {
+    cv::VideoCapture capture;
+    Task<MatType> task;
+    cv::Mat frame;
+    MatType taskFrame;
+    double fps = 0.0;
+    int decodedFrames = 0;
+    bool ended = false;
+    // frame was overlaid in current scene frame
+    bool changed = false;
+
+    explicit SlotState(Task<MatType>&& task): task(std::move(task)) {}
+
+    // decodes frames up to the one shown at given scene time, and overlays the last of them
+    void advance(double seconds) {
+        int target = (int) std::floor(seconds * fps + 1e-6);
+        changed = false;
+        while (!ended && decodedFrames <= target) {
+            if (!decodeFrame(capture, frame)) {
+                ended = true;
+                break;
+            }
+            decodedFrames += 1;
+            changed = true;
+        }
+        if (changed) {
+            task.composeFrame(uploadFrame(frame, taskFrame));
+        }
+    }
+};
+
+/**
+ * Long-lived thread advancing single slot, so that slots are decoded concurrently
+ * without creating thread per slot and scene frame
+ */
+class SlotDecoder {
+private:
+    std::function<void(double)> _advance;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    double _seconds = 0.0;
+    bool _requested = false;
+    bool _stopped = false;
+    std::exception_ptr _error;
+    std::thread _thread;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _condition.wait(lock, [this]() { return _requested || _stopped; });
+            if (_stopped) {
+                return;
+            }
+            double seconds = _seconds;
+            lock.unlock();
+            std::exception_ptr error;
+            try {
+                _advance(seconds);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+            _error = error;
+            _requested = false;
+            _condition.notify_all();
+        }
+    }
+public:
+    explicit SlotDecoder(std::function<void(double)> advance): _advance(std::move(advance)) {
+        _thread = std::thread(withCallerOpenCL([this]() { run(); }));
+    }
+
+    ~SlotDecoder() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopped = true;
+        }
+        _condition.notify_all();
+        _thread.join();
+    }
+
+    SlotDecoder(const SlotDecoder&) = delete;
+    SlotDecoder& operator=(const SlotDecoder&) = delete;
+
+    // starts advancing slot to given scene time
+    void request(double seconds) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _seconds = seconds;
+            _requested = true;
+        }
+        _condition.notify_all();
+    }
+
+    // waits until requested advance is done, rethrows its error
+    void wait() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return !_requested; });
+        if (_error) {
+            std::rethrow_exception(std::exchange(_error, nullptr));
+        }
+    }
+};
+
+} // namespace
+
+template<class MatType>
+RenderStats renderScene(
+    const std::vector<SceneSlot>& slots,
+    const OutputConfig& sceneConfig,
+    const ProgressCallback& progress
+) {
+    if (slots.empty()) {
+        throw std::invalid_argument("Scene has no slots");
+    }
+    if (!sceneConfig.isValid()) {
+        throw std::invalid_argument("OutputConfig is not valid!");
+    }
+
+    // background (with shadows of slots) is drawn once, slots overwrite only pixels covered by device
+    cv::Mat background = renderBackground(sceneConfig);
+    cv::Mat canvas;
+
+    // every slot task draws its output into canvas
+    std::vector<std::unique_ptr<SlotState<MatType>>> states;
+    int totalFrames = 0;
+    for (const auto& slot : slots) {
+        auto state = std::make_unique<SlotState<MatType>>(slot.overlayer->overlayTask<MatType>(slot.outputConfig));
+        openInput(state->capture, slot.inputPath, slot.outputConfig);
+        state->fps = state->capture.get(cv::CAP_PROP_FPS);
+        if (state->fps <= 0.0) {
+            state->fps = sceneConfig.fps;
+        }
+        int frames = (int) state->capture.get(cv::CAP_PROP_FRAME_COUNT);
+        totalFrames = std::max(totalFrames, (int) std::ceil(frames * sceneConfig.fps / state->fps));
+
+        states.push_back(std::move(state));
+    }
+    for (size_t i = 0; i < slots.size(); i++) {
+        cv::Mat silhouette;
+        states[i]->task.coverageMask().convertTo(silhouette, CV_32F, 1.0 / 255.0);
+        cv::Rect rect(slots[i].origin, silhouette.size());
+        if ((rect & cv::Rect(0, 0, background.cols, background.rows)) == rect) {
+            applyDropShadow(background, sceneConfig.background, silhouette, rect);
+        }
+    }
+    background.convertTo(canvas, CV_8U);
+    for (size_t i = 0; i < slots.size(); i++) {
+        auto& task = states[i]->task;
+        // slot is rendered over its part of scene background, so that device edges blend with it
+        cv::Rect rect(slots[i].origin, cv::Size(slots[i].outputConfig.width, slots[i].outputConfig.height));
+        if ((rect & cv::Rect(0, 0, background.cols, background.rows)) == rect) {
+            task.setBackground(background(rect));
+        }
+        task.initialize(std::make_unique<CanvasWriter>(canvas, slots[i].origin, task.coverageMask()));
+        if (!task.isActive()) {
+            throw std::invalid_argument("Scene slot of " + slots[i].inputPath + " does not fit in canvas");
+        }
+    }
+
+    auto writer = FrameWriter::create(sceneConfig.path, sceneConfig.audioSourcePath, sceneConfig.crf);
+    if (!writer->open(sceneConfig.path, sceneConfig.fps, canvas.size())) {
+        throw std::runtime_error("Unable to open output " + sceneConfig.path);
+    }
+    DEBUG_PRINTLN("*** Scene: " << slots.size() << " slots, backend: " << writer->backendName());
+
+    int index = 0;
+    std::vector<std::unique_ptr<SlotDecoder>> decoders;
+    for (auto& state : states) {
+        decoders.push_back(std::make_unique<SlotDecoder>([&state = *state](double seconds) { state.advance(seconds); }));
+    }
+    while (true) {
+        // inputs are decoded and overlaid concurrently
+        double seconds = index / sceneConfig.fps;
+        for (auto& decoder : decoders) {
+            decoder->request(seconds);
+        }
+        for (auto& decoder : decoders) {
+            decoder->wait();
+        }
+
+        bool active = std::any_of(states.begin(), states.end(), [](const auto& state) { return !state->ended; });
+        if (!active && std::none_of(states.begin(), states.end(), [](const auto& state) { return state->changed; })) {
+            break;
+        }
+
+        // slots are drawn in order, so later slots stay on top where they overlap
+        auto firstChanged = std::find_if(states.begin(), states.end(), [](const auto& state) { return state->changed; });
+        {
+            SF_PROFILE_STAGE(Stage::Encode);
+            for (auto it = firstChanged; it != states.end(); ++it) {
+                if ((*it)->decodedFrames > 0) {
+                    (*it)->task.writeFrame();
+                }
+            }
+            writer->write(canvas);
+        }
+        if (progress) {
+            progress(index, totalFrames);
+        }
+        index += 1;
+    }
+
+    decoders.clear();
+    RenderStats stats;
+    for (auto& state : states) {
+        state->capture.release();
+        state->task.finalize();
+        stats.taskAllocatedBytes += state->task.allocatedBytes() + state->task.sharedBytes();
+    }
+    writer->release();
+    stats.frameCount = index;
+
+    return stats;
+}
+
+// Preview
+
+// positions input at given time, frames before it are skipped when backend can't seek
+static void seekInput(cv::VideoCapture& cap, double seconds) {
+    if (seconds <= 0.0 || cap.set(cv::CAP_PROP_POS_MSEC, seconds * 1000.0)) {
+        return;
+    }
+    int skippedFrames = (int) std::lround(seconds * cap.get(cv::CAP_PROP_FPS));
+    for (int i = 0; i < skippedFrames && cap.grab(); i++) {}
+}
+
+template<class MatType>
+RenderStats renderPreview(
+    Overlayer& overlayer,
+    const std::string& inputPath,
+    const OutputConfig& outputConfig,
+    double seconds,
+    double duration,
+    const std::vector<int>& writeParams,
+    const ProgressCallback& progress
+) {
+    auto task = overlayer.overlayTask<MatType>(outputConfig);
+    if (duration > 0.0) {
+        task.initialize();
+    } else {
+        task.initialize(std::make_unique<ImageWriter>(std::vector<std::string>{outputConfig.path}, writeParams));
+    }
+    if (!task.isActive()) {
+        throw std::runtime_error("Unable to open output " + outputConfig.path);
+    }
+
+    int totalFrames = duration > 0.0 ? std::max(1, (int) std::ceil(duration * outputConfig.fps)) : 1;
+    cv::Mat frame;
+    usePool(frame);
+    MatType taskFrame;
+    int index = 0;
+    if (isRawVideoPath(inputPath)) {
+        // mapped frames are accessed directly, without seeking
+        std::unique_ptr<MappedVideo> video = openMappedVideo(inputPath, outputConfig);
+        int firstFrame = (int) std::lround(seconds * video->format().fps);
+        for (; index < totalFrames && firstFrame + index < video->frameCount(); index++) {
+            cv::Mat* rawFrame;
+            {
+                SF_PROFILE_STAGE(Stage::Decode);
+                rawFrame = &video->readFrame(firstFrame + index, frame);
+            }
+            task.feedFrame(uploadFrame(*rawFrame, taskFrame));
+            if (progress) {
+                progress(index, totalFrames);
+            }
+        }
+    } else {
+        cv::VideoCapture cap;
+        openInput(cap, inputPath, outputConfig);
+        seekInput(cap, seconds);
+        for (; index < totalFrames && decodeFrame(cap, frame); index++) {
+            task.feedFrame(uploadFrame(frame, taskFrame));
+            if (progress) {
+                progress(index, totalFrames);
+            }
+        }
+        cap.release();
+    }
+    task.finalize();
+    if (index == 0) {
+        throw std::runtime_error("Input has no frame at " + std::to_string(seconds) + " s");
+    }
+
+    RenderStats stats;
+    stats.frameCount = index;
+    stats.taskAllocatedBytes = task.allocatedBytes() + task.sharedBytes();
+    return stats;
+}
+
+// explicit instantiation
+template RenderStats renderVideo<cv::Mat>(Overlayer&, const std::string&, const OutputConfig&, const ProgressCallback&);
+template RenderStats renderVideo<cv::UMat>(Overlayer&, const std::string&, const OutputConfig&, const ProgressCallback&);
+template RenderStats renderVideoSegmented<cv::Mat>(Overlayer&, const std::string&, const OutputConfig&, int, const ProgressCallback&);
+template RenderStats renderVideoSegmented<cv::UMat>(Overlayer&, const std::string&, const OutputConfig&, int, const ProgressCallback&);
+template RenderStats renderImages<cv::Mat>(Overlayer&, const std::vector<ImageItem>&, const OutputConfig&, int, const std::vector<int>&, const ProgressCallback&);
+template RenderStats renderImages<cv::UMat>(Overlayer&, const std::vector<ImageItem>&, const OutputConfig&, int, const std::vector<int>&, const ProgressCallback&);
+template RenderStats renderScene<cv::Mat>(const std::vector<SceneSlot>&, const OutputConfig&, const ProgressCallback&);
+template RenderStats renderScene<cv::UMat>(const std::vector<SceneSlot>&, const OutputConfig&, const ProgressCallback&);
+template RenderStats renderPreview<cv::Mat>(Overlayer&, const std::string&, const OutputConfig&, double, double, const std::vector<int>&, const ProgressCallback&);
+template RenderStats renderPreview<cv::UMat>(Overlayer&, const std::string&, const OutputConfig&, double, double, const std::vector<int>&, const ProgressCallback&);
+
+} // namespace avo
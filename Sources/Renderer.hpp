@@ -0,0 +1,144 @@
+#ifndef SCREENFRAMER_RENDERER_HPP
+#define SCREENFRAMER_RENDERER_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include "Overlayer.hpp"
+#include "OutputConfig.hpp"
+#include "Remux.hpp"
+
+namespace avo {
+
+// progress callback, receives number of processed frames and total frame count
+using ProgressCallback = std::function<void(int, int)>;
+
+// Summary of finished rendering
+struct RenderStats {
+    int frameCount = 0;
+    // bytes held by task frame buffers (sum over concurrently running tasks, shared template assets counted once)
+    size_t taskAllocatedBytes = 0;
+};
+
+// Input and output path of single still image
+struct ImageItem {
+    std::string inputPath;
+    std::string outputPath;
+};
+
+// Recording placed in device frame at given position of scene canvas
+struct SceneSlot {
+    std::string inputPath;
+    std::shared_ptr<Overlayer> overlayer;
+    // output of slot alone: size, template rotation, scaling options (path is not used)
+    OutputConfig outputConfig;
+    // position of slot in canvas
+    cv::Point origin;
+};
+
+// Range of frames [firstFrame, endFrame), bounded by presentation timestamps [startMs, endMs)
+struct Segment {
+    int firstFrame;
+    int endFrame;
+    // -infinity for first segment, +infinity for last one (read until end of video)
+    double startMs;
+    double endMs;
+
+    int length() const;
+};
+
+/**
+ * Divides video into at most count segments, each starting at key frame
+ * @param keyframes key frames ordered by presentation
+ * @param totalFrames (possibly estimated) number of frames in video, used to balance segments
+ * @param count desired number of segments
+ * @return segments covering whole video, the last one is open-ended
+ */
+std::vector<Segment> planSegments(const std::vector<Keyframe>& keyframes, int totalFrames, int count);
+
+/**
+ * Reads rotation from video metadata
+ * @return clockwise rotation in degrees (0, 90, 180, 270), which displays decoded frames upright
+ */
+int probeFrameRotation(const std::string& inputPath);
+
+/**
+ * Decodes input video, overlays every frame and encodes result at output path
+ * MatType selects processing backend: cv::Mat - CPU, cv::UMat - OpenCL (T-API)
+ */
+template<class MatType>
+RenderStats renderVideo(
+    Overlayer& overlayer,
+    const std::string& inputPath,
+    const OutputConfig& outputConfig,
+    const ProgressCallback& progress = {}
+);
+
+/**
+ * Splits input video at key frames into segmentCount parts, which are decoded, overlaid
+ * and encoded concurrently, and then concatenated into output path without re-encoding.
+ */
+template<class MatType>
+RenderStats renderVideoSegmented(
+    Overlayer& overlayer,
+    const std::string& inputPath,
+    const OutputConfig& outputConfig,
+    int segmentCount,
+    const ProgressCallback& progress = {}
+);
+
+/**
+ * Overlays still images with output configuration shared by all of them (e.g. screenshots
+ * of the same resolution). Images are divided between workerCount tasks, which decode,
+ * overlay and encode their share concurrently, sharing prepared template assets.
+ * @param writeParams cv::imwrite parameters, e.g. {cv::IMWRITE_PNG_COMPRESSION, 3}
+ * @return stats, frameCount is number of written images
+ */
+template<class MatType>
+RenderStats renderImages(
+    Overlayer& overlayer,
+    const std::vector<ImageItem>& items,
+    const OutputConfig& outputConfig,
+    int workerCount,
+    const std::vector<int>& writeParams = {},
+    const ProgressCallback& progress = {}
+);
+
+/**
+ * Overlays several recordings, each in its own device frame, into single output in one pass.
+ * Inputs are decoded in lockstep at scene frame rate (ended inputs hold their last frame),
+ * slots are overlaid concurrently, drawn over background in order and encoded once.
+ * @param sceneConfig canvas size, background color, frame rate, output path and audio source
+ */
+template<class MatType>
+RenderStats renderScene(
+    const std::vector<SceneSlot>& slots,
+    const OutputConfig& sceneConfig,
+    const ProgressCallback& progress = {}
+);
+
+/**
+ * Overlays frames of input starting at given time, without processing whole video.
+ * Single frame (duration 0) is written as image (PNG/JPEG by output path extension), longer
+ * previews as clip in format selected by output path. Output config is usually downscaled,
+ * so that template assets are prepared (and cached by overlayer) at preview size.
+ * @param seconds timestamp of first frame
+ * @param duration length of clip in seconds, 0 - single frame
+ * @param writeParams cv::imwrite parameters of single frame
+ * @throws std::runtime_error if input has no frame at given time
+ */
+template<class MatType>
+RenderStats renderPreview(
+    Overlayer& overlayer,
+    const std::string& inputPath,
+    const OutputConfig& outputConfig,
+    double seconds,
+    double duration,
+    const std::vector<int>& writeParams = {},
+    const ProgressCallback& progress = {}
+);
+
+} // namespace avo
+
+#endif //SCREENFRAMER_RENDERER_HPP
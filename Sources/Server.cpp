@@ -0,0 +1,341 @@
+#include "Server.hpp"
+#include "LRUCache.hpp"
+#include "FramePool.hpp"
+#include "Debug.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// maximum length of request line
+constexpr size_t MAX_REQUEST_SIZE = 64 * 1024;
+// interval of checking for termination while waiting for connections
+constexpr int ACCEPT_POLL_MS = 200;
+
+std::atomic<bool> stopRequested(false);
+
+void handleSignal(int) {
+    stopRequested.store(true);
+}
+
+bool makeAddress(const std::string& socketPath, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    return true;
+}
+
+// reads bytes until newline or end of stream
+bool readLine(int fd, std::string& line) {
+    line.clear();
+    char buffer[4096];
+    while (line.size() < MAX_REQUEST_SIZE) {
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return !line.empty();
+        }
+        line.append(buffer, count);
+        size_t newline = line.find('\n');
+        if (newline != std::string::npos) {
+            line.resize(newline);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t count = write(fd, data.data() + written, data.size() - written);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        written += count;
+    }
+    return true;
+}
+
+json errorResponse(int code, const std::string& message) {
+    return {{"status", "error"}, {"code", code}, {"message", message}};
+}
+
+// Bounded FIFO of accepted client connections
+class ConnectionQueue {
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<int> _fds;
+    size_t _capacity;
+    bool _closed = false;
+public:
+    explicit ConnectionQueue(size_t capacity): _capacity(capacity) {}
+
+    // returns false if queue is full
+    bool push(int fd) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_fds.size() >= _capacity) {
+                return false;
+            }
+            _fds.push_back(fd);
+        }
+        _condition.notify_one();
+        return true;
+    }
+
+    // blocks until connection is available, returns -1 when queue is closed and drained
+    int pop() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return _closed || !_fds.empty(); });
+        if (_fds.empty()) {
+            return -1;
+        }
+        int fd = _fds.front();
+        _fds.pop_front();
+        return fd;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _condition.notify_all();
+    }
+};
+
+using OverlayerCache = avo::LRUCache<std::string, std::shared_ptr<avo::Overlayer>>;
+
+json handleRequest(const std::string& line, const json& contents, OverlayerCache& overlayers, const OutputCache* outputCache) {
+    JobRequest request;
+    try {
+        json::parse(line).get_to(request);
+    } catch (const std::exception& e) {
+        return errorResponse(1, std::string("Invalid request: ") + e.what());
+    }
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        auto overlayerFor = [&overlayers](const avo::OverlayConfig& config) {
+            return overlayers.getOrCreate(config.imagePath, [&config]() {
+                return std::make_shared<avo::Overlayer>(config);
+            });
+        };
+        avo::RenderStats stats;
+        bool cached = false;
+        if (request.scene) {
+            stats = renderSceneJob(resolveScene(request, contents), overlayerFor);
+        } else if (isImageInput(request.inputPath)) {
+            stats = renderImageJob(request, contents, overlayerFor);
+        } else if (request.isPreview()) {
+            // template assets of preview size stay cached with overlayer, so repeated previews only decode and blend
+            ResolvedJob job = resolveJob(request, contents);
+            stats = renderPreviewJob(job, *overlayerFor(job.overlayConfig));
+        } else {
+            ResolvedJob job = resolveJob(request, contents);
+            std::string cacheKey = outputCache != nullptr ? OutputCache::key(job) : "";
+            cached = outputCache != nullptr && outputCache->restore(cacheKey, request.outputPath);
+            if (!cached) {
+                auto overlayer = overlayerFor(job.overlayConfig);
+                stats = renderJob(job, *overlayer);
+                if (outputCache != nullptr) {
+                    outputCache->store(cacheKey, request.outputPath);
+                }
+            }
+        }
+        std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        std::cout << "*** Rendered " << request.inputPath << " -> " << request.outputPath
+                  << (cached ? " (cached, " : " (" + std::to_string(stats.frameCount) + " frames, ")
+                  << duration.count() << " s)" << std::endl;
+        return {
+            {"status", "ok"},
+            {"output", request.outputPath},
+            {"frames", stats.frameCount},
+            {"seconds", duration.count()},
+            {"cached", cached}
+        };
+    } catch (const JobError& e) {
+        return errorResponse(e.code(), e.what());
+    } catch (const std::exception& e) {
+        return errorResponse(5, e.what());
+    }
+}
+
+void handleConnection(int fd, const json& contents, OverlayerCache& overlayers, const OutputCache* outputCache) {
+    std::string line;
+    json response;
+    if (readLine(fd, line)) {
+        response = handleRequest(line, contents, overlayers, outputCache);
+        // frame buffers of finished (or failed) job are not kept by long-running daemon
+        avo::FramePool::shared().trim();
+    } else {
+        response = errorResponse(1, "Invalid request: expected single JSON line");
+    }
+    if (!writeAll(fd, response.dump() + "\n")) {
+        DEBUG_PRINTLN("*** Client disconnected before response");
+    }
+    close(fd);
+}
+
+}
+
+// Daemon
+
+int serveJobs(
+    const std::string& socketPath,
+    const json& contents,
+    int workerCount,
+    size_t cacheCapacity,
+    const OutputCache* outputCache
+) {
+    sockaddr_un address = {};
+    if (!makeAddress(socketPath, address)) {
+        std::cerr << "Error: Socket path is too long: " << socketPath << std::endl;
+        return 1;
+    }
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::cerr << "Error: Unable to create socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    // remove stale socket of previous instance
+    std::error_code ec;
+    if (fs::is_socket(socketPath, ec)) {
+        fs::remove(socketPath, ec);
+    }
+    // daemon reads and writes any path given by client, so only its owner may connect
+    // (socket is created with owner-only permissions, before workers are started)
+    mode_t previousMask = umask(077);
+    int bound = bind(listenFd, (sockaddr*) &address, sizeof(address));
+    umask(previousMask);
+    if (bound < 0 || listen(listenFd, SOMAXCONN) < 0) {
+        std::cerr << "Error: Unable to listen at " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(listenFd);
+        return 1;
+    }
+
+    // clients disconnecting before response must not terminate daemon
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    workerCount = std::max(1, workerCount);
+    OverlayerCache overlayers(std::max((size_t) 1, cacheCapacity));
+    // connections waiting for worker, excess clients are rejected instead of queued indefinitely
+    ConnectionQueue queue(4 * (size_t) workerCount);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back([&queue, &contents, &overlayers, outputCache]() {
+            int fd;
+            while ((fd = queue.pop()) >= 0) {
+                handleConnection(fd, contents, overlayers, outputCache);
+            }
+        });
+    }
+    std::cout << "*** Listening at " << socketPath << " with " << workerCount << " workers" << std::endl;
+
+    while (!stopRequested.load()) {
+        pollfd pfd = {listenFd, POLLIN, 0};
+        int ready = poll(&pfd, 1, ACCEPT_POLL_MS);
+        if (ready <= 0) {
+            continue;
+        }
+        int clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0) {
+            continue;
+        }
+        if (!queue.push(clientFd)) {
+            writeAll(clientFd, errorResponse(6, "Server is busy").dump() + "\n");
+            close(clientFd);
+        }
+    }
+
+    // finish queued jobs before exiting
+    std::cout << "*** Shutting down" << std::endl;
+    close(listenFd);
+    queue.close();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    fs::remove(socketPath, ec);
+
+    return 0;
+}
+
+// Client
+
+int submitJob(const std::string& socketPath, JobRequest request) {
+    sockaddr_un address = {};
+    if (!makeAddress(socketPath, address)) {
+        std::cerr << "Error: Socket path is too long: " << socketPath << std::endl;
+        return 1;
+    }
+    // daemon may run in different working directory
+    request.inputPath = fs::absolute(request.inputPath).string();
+    request.outputPath = fs::absolute(request.outputPath).string();
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*) &address, sizeof(address)) < 0) {
+        std::cerr << "Error: Unable to connect to " << socketPath << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::string line;
+    bool received = writeAll(fd, json(request).dump() + "\n") && readLine(fd, line);
+    close(fd);
+    if (!received) {
+        std::cerr << "Error: Connection to " << socketPath << " was interrupted" << std::endl;
+        return 1;
+    }
+
+    try {
+        json response = json::parse(line);
+        if (response.at("status") == "ok" && response.value("cached", false)) {
+            std::cout << "*** Restored from output cache: " << response.at("output").get<std::string>() << std::endl;
+            return 0;
+        }
+        if (response.at("status") == "ok") {
+            std::cout << "*** Rendered " << response.at("frames").get<int>() << " frames in "
+                      << response.at("seconds").get<double>() << " s: "
+                      << response.at("output").get<std::string>() << std::endl;
+            return 0;
+        }
+        std::cerr << "Error: " << response.at("message").get<std::string>() << std::endl;
+        return response.value("code", 5);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid response: " << e.what() << std::endl;
+        return 1;
+    }
+}
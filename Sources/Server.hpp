@@ -0,0 +1,43 @@
+#ifndef SCREENFRAMER_SERVER_HPP
+#define SCREENFRAMER_SERVER_HPP
+
+#include <string>
+#include <nlohmann/json.hpp>
+#include "Job.hpp"
+#include "OutputCache.hpp"
+
+using nlohmann::json;
+
+// Daemon mode
+// Protocol: client connects to unix domain socket and sends single job request as JSON line
+// (see JobRequest serialization), server replies with single JSON line and closes connection:
+// {"status": "ok", "output": ..., "frames": ..., "seconds": ..., "cached": ...} or
+// {"status": "error", "code": ..., "message": ...}, where code is command line tool exit code
+
+/**
+ * Accepts jobs on unix domain socket until SIGINT or SIGTERM is received
+ * Jobs are rendered by fixed number of workers, overlayers (decoded templates) are kept
+ * in LRU cache between jobs
+ * @param socketPath path of socket to create
+ * @param contents parsed contents.json
+ * @param workerCount number of concurrently rendered jobs
+ * @param cacheCapacity maximum number of cached overlayers
+ * @param outputCache cache of rendered videos, nullptr - disabled
+ * @return process exit code
+ */
+int serveJobs(
+    const std::string& socketPath,
+    const json& contents,
+    int workerCount,
+    size_t cacheCapacity,
+    const OutputCache* outputCache = nullptr
+);
+
+/**
+ * Sends job to daemon listening at socketPath and waits for its completion
+ * Relative input and output paths are resolved against current directory
+ * @return process exit code, the same as when job is rendered by command line tool
+ */
+int submitJob(const std::string& socketPath, JobRequest request);
+
+#endif //SCREENFRAMER_SERVER_HPP
@@ -8,6 +8,7 @@
 #include <filesystem>
 #include <algorithm>
 #include <fstream>
+#include <sys/resource.h>
 
 namespace fs = std::filesystem;
 
@@ -123,4 +124,16 @@ int autoTemplate(const std::vector<ContentsEntry>& entries, int inputWidth, int
     auto minIt = std::min_element(diffs.begin(), diffs.end());
     int minIndex = std::distance(diffs.begin(), minIt);
     return minIndex;
-}
\ No newline at end of file
+}
+// Memory usage
+
+size_t peakResidentBytes() {
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (size_t) usage.ru_maxrss;
+#else
+    // kilobytes on linux
+    return (size_t) usage.ru_maxrss * 1024;
+#endif
+}
@@ -59,4 +59,12 @@ void parseContentsJson(json& json);
  */
 int autoTemplate(const std::vector<ContentsEntry>& entries, int inputWidth, int inputHeight);
 
+// Memory usage
+
+/**
+ * Peak resident set size of the process
+ * @return size in bytes
+ */
+size_t peakResidentBytes();
+
 #endif //SCREENFRAMER_UTILITY_HPP
@@ -11,10 +11,21 @@
 #include <fstream>
 #include <algorithm>
 #include <cassert>
+#include <thread>
+#include <optional>
+#include <chrono>
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/ocl.hpp>
 #include <cxxopts.hpp>
 #include <nlohmann/json.hpp>
 #include "Overlayer.hpp"
+#include "Renderer.hpp"
+#include "Job.hpp"
+#include "Server.hpp"
+#include "OutputCache.hpp"
+#include "FramePool.hpp"
+#include "Placement.hpp"
+#include "Profiler.hpp"
 #include "Utility.hpp"
 #include "Debug.hpp"
 #include "tqdm.hpp"
@@ -46,6 +57,30 @@ void printTemplateHelp(nlohmann::json& configJson) {
     }
 }
 
+// prints error of job preparation and returns its exit code
+int reportJobError(const JobError& e, nlohmann::json& configJson) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    if (e.code() == 3) {
+        printTemplateHelp(configJson);
+    }
+    return e.code();
+}
+
+// prints statistics of finished rendering and writes trace if requested
+void reportRenderStats(const avo::RenderStats& stats, double seconds, bool printStats, const std::string& tracePath) {
+    if (printStats) {
+        avo::Profiler::printSummary(std::cout, stats.frameCount, seconds);
+        std::cout << "*** Throughput: " << (seconds > 0 ? stats.frameCount / seconds : 0.0) << " fps"
+                  << " (" << avo::currentPlacement().description() << ")" << std::endl;
+        std::cout << "*** Task memory: " << stats.taskAllocatedBytes / (1024 * 1024) << " MB"
+                  << ", peak RSS: " << peakResidentBytes() / (1024 * 1024) << " MB" << std::endl;
+    }
+    if (!tracePath.empty() && !avo::Profiler::writeChromeTrace(tracePath)) {
+        std::cerr << "Error: Unable to write trace to " << tracePath << std::endl;
+    }
+    DEBUG_PRINTLN("*** Frame pool peak: " << avo::FramePool::shared().peakLeasedBytes() / (1024 * 1024) << " MB");
+}
+
 /**
  * Usage: avframer VIDEOPATH OUTPUTPATH
  *
@@ -55,12 +90,16 @@ void printTemplateHelp(nlohmann::json& configJson) {
  * -h,height - Output video height
  */
 int main(int argc, char** argv) {
-    std::string videoPath;
-    std::string outputPath;
-    std::string templateKey;
-    std::string paddingStr;
-    avo::RGBColor backgroundColor;
-    int width, height;
+    JobRequest request;
+    bool printStats;
+    std::string tracePath;
+    std::string serveSocket;
+    std::string submitSocket;
+    int workerCount;
+    size_t cacheCapacity;
+    std::string outputCacheDirectory;
+    uintmax_t outputCacheLimit;
+    avo::Placement placement;
 
     // load template json from resources
     nlohmann::json configJson;
@@ -74,10 +113,42 @@ int main(int argc, char** argv) {
         ("h,height", "Output video height", cxxopts::value<int>()->default_value("0"))
         ("p,padding", "Output video padding", cxxopts::value<std::string>()->default_value("0.16:"))
         ("c,color", "Background color", cxxopts::value<std::string>()->default_value("#000000"))
+        ("background-image", "Image covering background (scaled to fill output)", cxxopts::value<std::string>())
+        ("gradient", "Background gradient from --color: linear:#RRGGBB[:ANGLE], radial:#RRGGBB", cxxopts::value<std::string>())
+        ("shadow", "Device drop shadow BLUR[:OFFSETX:OFFSETY[:OPACITY]], fractions of device height (e.g. 0.02:0:0.01:0.5)", cxxopts::value<std::string>())
+        ("j,segments", "Number of segments rendered in parallel (0 - number of cores)", cxxopts::value<int>()->default_value("1"))
+        ("b,backend", "Processing backend: cpu, opencl", cxxopts::value<std::string>()->default_value("cpu"))
+        ("r,rotation", "Device rotation clockwise in degrees: auto, 0, 90, 180, 270", cxxopts::value<std::string>()->default_value("auto"))
+        ("no-audio", "Do not copy audio of input video into output")
+        ("crf", "Quality of video encoded together with audio, 0 (best) - 51 (worst)", cxxopts::value<int>()->default_value("23"))
+        ("scale-at-decode", "Let decoder downscale large inputs to screen size (requires OpenCV with GStreamer)")
+        ("compact", "Compact memory mode (8-bit buffers, in-place blending)")
+        ("deep-color", "Keep 10-bit (HDR) input: 16-bit blending, 10-bit HEVC output with colorimetry of input (requires libav)")
+        ("raw-input", "Geometry of headerless raw input (.yuv - I420, .bgr - BGR24) as WIDTHxHEIGHT@FPS", cxxopts::value<std::string>())
+        ("scene", "Input is scene description (JSON) placing multiple recordings in one output")
+        ("preview", "Render only frame at given time in seconds, written as PNG/JPEG image", cxxopts::value<double>())
+        ("preview-duration", "Render preview clip of given length in seconds, instead of single frame", cxxopts::value<double>()->default_value("0"))
+        ("preview-scale", "Size of preview relative to output size", cxxopts::value<double>()->default_value("0.5"))
+        ("png-compression", "PNG compression level of image outputs (0-9)", cxxopts::value<int>()->default_value("3"))
+        ("scale-filter", "Resampling filter for non-integer scaling: area, bilinear, lanczos", cxxopts::value<std::string>()->default_value("bilinear"))
+        ("cpus", "CPUs of processing threads (e.g. 0-7,16-23), also of decoder and encoder unless given separately", cxxopts::value<std::string>())
+        ("decode-cpus", "CPUs of decoder threads", cxxopts::value<std::string>())
+        ("encode-cpus", "CPUs of encoder threads", cxxopts::value<std::string>())
+        ("numa-node", "NUMA node of frame buffers, and of threads not pinned otherwise (Linux)", cxxopts::value<int>())
+        ("threads", "Number of OpenCV worker threads (0 - number of --cpus, or all cores)", cxxopts::value<int>()->default_value("0"))
+        ("huge-pages", "Back frame buffers with transparent huge pages (Linux)")
+        ("stats", "Print per-stage processing statistics and memory usage")
+        ("trace", "Write Chrome/Perfetto trace of processing stages to given path", cxxopts::value<std::string>())
+        ("serve", "Run as daemon accepting jobs on given unix socket", cxxopts::value<std::string>())
+        ("submit", "Send job to daemon listening on given unix socket", cxxopts::value<std::string>())
+        ("workers", "Number of jobs rendered concurrently by daemon (0 - number of cores)", cxxopts::value<int>()->default_value("0"))
+        ("cache", "Number of device templates kept in memory by daemon", cxxopts::value<size_t>()->default_value("8"))
+        ("output-cache", "Directory of cached outputs, identical jobs are restored from it instead of rendering", cxxopts::value<std::string>())
+        ("output-cache-limit", "Size limit of output cache in MB", cxxopts::value<size_t>()->default_value("4096"))
         ("help", "Print help")
         ("version", "Print version")
-        ("inputVideo", "Input video", cxxopts::value<std::string>())
-        ("outputVideo", "Output video", cxxopts::value<std::string>())
+        ("inputVideo", "Input video, or directory/glob pattern of PNG/JPEG screenshots", cxxopts::value<std::string>())
+        ("outputVideo", "Output video, or output directory of screenshots", cxxopts::value<std::string>())
         ;
     options.parse_positional({"inputVideo", "outputVideo"});
     options.positional_help("VIDEOPATH OUTPUTPATH");
@@ -94,119 +165,246 @@ int main(int argc, char** argv) {
             std::cout << VERSION_NUMBER << std::endl;
             return 0;
         }
-        videoPath = result["inputVideo"].as<std::string>();
-        outputPath = result["outputVideo"].as<std::string>();
-        templateKey = result["template"].as<std::string>();
-        width = result["width"].as<int>();
-        height = result["height"].as<int>();
-        paddingStr = result["padding"].as<std::string>();
-        std::string rgbHexStr = result["color"].as<std::string>();
-        backgroundColor = {rgbHexStr};
+        avo::FramePool::shared().setHugePages(result.count("huge-pages") > 0);
+        if (result.count("cpus")) {
+            placement.composeCpus = avo::parseCpuList(result["cpus"].as<std::string>());
+            placement.decodeCpus = placement.encodeCpus = placement.composeCpus;
+        }
+        if (result.count("decode-cpus")) {
+            placement.decodeCpus = avo::parseCpuList(result["decode-cpus"].as<std::string>());
+        }
+        if (result.count("encode-cpus")) {
+            placement.encodeCpus = avo::parseCpuList(result["encode-cpus"].as<std::string>());
+        }
+        if (result.count("numa-node")) {
+            placement.numaNode = result["numa-node"].as<int>();
+        }
+        placement.threads = result["threads"].as<int>();
+        workerCount = result["workers"].as<int>();
+        if (workerCount <= 0) {
+            workerCount = (int) std::max(1u, std::thread::hardware_concurrency());
+        }
+        cacheCapacity = result["cache"].as<size_t>();
+        if (result.count("output-cache")) {
+            outputCacheDirectory = result["output-cache"].as<std::string>();
+        }
+        outputCacheLimit = (uintmax_t) result["output-cache-limit"].as<size_t>() * 1024 * 1024;
+        if (result.count("serve")) {
+            serveSocket = result["serve"].as<std::string>();
+        } else {
+            request.inputPath = result["inputVideo"].as<std::string>();
+            request.outputPath = result["outputVideo"].as<std::string>();
+        }
+        if (result.count("submit")) {
+            submitSocket = result["submit"].as<std::string>();
+        }
+        request.templateKey = result["template"].as<std::string>();
+        request.width = result["width"].as<int>();
+        request.height = result["height"].as<int>();
+        request.padding = result["padding"].as<std::string>();
+        request.color = result["color"].as<std::string>();
+        // validate color early, as other option errors
+        avo::RGBColor backgroundColor(request.color);
+        avo::Background background;
+        if (result.count("background-image")) {
+            request.backgroundImage = result["background-image"].as<std::string>();
+        }
+        if (result.count("gradient")) {
+            request.gradient = result["gradient"].as<std::string>();
+            avo::parseGradient(request.gradient, background);
+        }
+        if (result.count("shadow")) {
+            request.shadow = result["shadow"].as<std::string>();
+            avo::parseShadow(request.shadow, background);
+        }
+        request.compactMemory = result.count("compact") > 0;
+        request.deepColor = result.count("deep-color") > 0;
+        request.scaleFilter = result["scale-filter"].as<std::string>();
+        avo::parseScaleFilter(request.scaleFilter);
+        request.scaleAtDecode = result.count("scale-at-decode") > 0;
+        request.rotation = result["rotation"].as<std::string>();
+        request.copyAudio = result.count("no-audio") == 0;
+        request.crf = result["crf"].as<int>();
+        printStats = result.count("stats") > 0;
+        if (result.count("trace")) {
+            tracePath = result["trace"].as<std::string>();
+        }
+        request.backend = result["backend"].as<std::string>();
+        if (request.backend != "cpu" && request.backend != "opencl") {
+            throw std::invalid_argument("Unknown backend \"" + request.backend + "\"");
+        }
+        request.segments = result["segments"].as<int>();
+        // images are independent, so image mode uses all cores unless told otherwise
+        if (!result.count("segments") && !result.count("scene") && !request.inputPath.empty()
+            && isImageInput(request.inputPath)) {
+            request.segments = 0;
+        }
+        request.pngCompression = result["png-compression"].as<int>();
+        if (result.count("preview")) {
+            request.previewTime = result["preview"].as<double>();
+            if (request.previewTime < 0.0) {
+                throw std::invalid_argument("Preview time must not be negative");
+            }
+        } else if (result.count("preview-duration")) {
+            request.previewTime = 0.0;
+        }
+        request.previewDuration = result["preview-duration"].as<double>();
+        request.previewScale = result["preview-scale"].as<double>();
+        request.scene = result.count("scene") > 0;
+        if (result.count("raw-input")) {
+            request.rawInput = result["raw-input"].as<std::string>();
+        }
     } catch (const std::exception& e) {
         std::cerr << "Error parsing options: " << e.what() << std::endl << std::endl;
         std::cout << options.help() << std::endl;
         return 1;
     }
 
-    // check if input file exists
-    if (!fs::exists(videoPath)) {
-        std::cerr << "Input video file does not exist at: " << videoPath << std::endl;
-        return 2;
+    // threads started from now on (OpenCV pool, daemon workers, decoders, encoders) run on given CPUs
+    if (!placement.isEmpty()) {
+        try {
+            avo::applyPlacement(placement);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
     }
 
-    // initialize video cap using input video
-    cv::VideoCapture cap(videoPath);
-    int totalFrames = (int) cap.get(cv::CAP_PROP_FRAME_COUNT);
-    int inputWidth = (int) cap.get(cv::CAP_PROP_FRAME_WIDTH);
-    int inputHeight = (int) cap.get(cv::CAP_PROP_FRAME_HEIGHT);
-    double fps = cap.get(cv::CAP_PROP_FPS);
-    DEBUG_PRINTLN("*** Total frames: " << totalFrames << ", fps: " << fps);
-    DEBUG_PRINTLN("*** Input frame dimensions: [" << inputWidth << ", " << inputHeight << "]");
+    // daemon and client modes
+    std::optional<OutputCache> outputCache;
+    if (!outputCacheDirectory.empty()) {
+        outputCache.emplace(outputCacheDirectory, outputCacheLimit);
+    }
+    if (!serveSocket.empty()) {
+        return serveJobs(serveSocket, configJson, workerCount, cacheCapacity, outputCache ? &*outputCache : nullptr);
+    }
+    if (!submitSocket.empty()) {
+        return submitJob(submitSocket, request);
+    }
 
-    // parse template config
-    avo::OverlayConfig config;
-    if (templateKey == "auto") {
-        // automatic template selection
-        std::vector<ContentsEntry> entries;
-        for (auto it = configJson.begin(); it != configJson.end(); ++it) {
-            entries.push_back(it.value().get<ContentsEntry>());
+    // OpenCL (T-API) setup, device can be chosen with OPENCV_OPENCL_DEVICE (e.g. ":CPU:" for POCL)
+    if (request.backend == "opencl") {
+        if (!cv::ocl::haveOpenCL()) {
+            std::cerr << "Error: OpenCL is not available" << std::endl;
+            return 1;
         }
-        int index = autoTemplate(entries, inputWidth, inputHeight);
-        entries[index].toOverlayConfig(config);
-        // print detected template
-        auto pathNoExt = fs::path(config.imagePath).replace_extension("");
-        std::cout << "*** Detected template: " << pathNoExt.filename() << std::endl;
-    } else {
+        if (request.compactMemory) {
+            std::cerr << "Error: Compact memory mode is supported only by cpu backend" << std::endl;
+            return 1;
+        }
+        cv::ocl::setUseOpenCL(true);
+        std::cout << "*** OpenCL device: " << cv::ocl::Device::getDefault().name() << std::endl;
+    }
+
+    auto overlayerFor = [](const avo::OverlayConfig& config) { return std::make_shared<avo::Overlayer>(config); };
+
+    // multi-device scene mode
+    if (request.scene) {
+        std::optional<ResolvedScene> scene;
         try {
-            auto result = parseTemplateKey(templateKey);
-            auto deviceKey = std::get<0>(result);
-            auto colorKey = std::get<1>(result);
-            if (!configJson.contains(deviceKey)) {
-                throw std::runtime_error("Invalid device key \"" + deviceKey + "\"");
-            }
+            scene = resolveScene(request, configJson);
+        } catch (const JobError& e) {
+            return reportJobError(e, configJson);
+        }
+        avo::OutputConfig& output = scene->outputConfig;
+        std::cout << "*** Scene configuration: " << scene->slots.size() << " slots, " << output.width << "x" << output.height
+                  << ", " << output.fps << "fps" << ", " << output.backgroundColor.hexString() << std::endl;
 
-            auto entry = configJson[deviceKey].get<ContentsEntry>();
-            entry.toOverlayConfig(config, colorKey);
+        avo::Profiler::setEnabled(printStats || !tracePath.empty());
+        auto renderStart = std::chrono::steady_clock::now();
+        tqdm pbar;
+        auto progress = [&pbar](int index, int total) { pbar.progress(index, total); };
+        avo::RenderStats stats;
+        try {
+            stats = renderSceneJob(*scene, overlayerFor, progress);
         } catch (const std::exception& e) {
             std::cerr << "Error: " << e.what() << std::endl;
-            printTemplateHelp(configJson);
-            // release resources
-            cap.release();
-            return 3;
+            return 5;
         }
+        pbar.finish();
+        std::chrono::duration<double> renderDuration = std::chrono::steady_clock::now() - renderStart;
+        reportRenderStats(stats, renderDuration.count(), printStats, tracePath);
+        return 0;
     }
 
-    assert(config.isValid());
-    DEBUG_PRINTLN("*** Config: path - " << config.imagePath << ", ox - " << config.screenLeft << ", oy - " << config.screenTop);
-    DEBUG_PRINTLN("***         width - " << config.templateWidth << ", height - " << config.templateHeight);
-    avo::Overlayer ovl(config);
-
-    // padding setup
-    std::tuple<double, double> padding;
-    if (!parsePadding(paddingStr, padding, {config.templateWidth, config.templateHeight})) {
-        std::cerr << "Error: Invalid padding string " << paddingStr << std::endl;
-        // release resources
-        cap.release();
-        return 4;
+    // still image (screenshot) mode
+    if (isImageInput(request.inputPath)) {
+        avo::Profiler::setEnabled(printStats || !tracePath.empty());
+        auto renderStart = std::chrono::steady_clock::now();
+        tqdm pbar;
+        auto progress = [&pbar](int index, int total) { pbar.progress(index, total); };
+        avo::RenderStats stats;
+        try {
+            stats = renderImageJob(request, configJson, overlayerFor, progress);
+        } catch (const JobError& e) {
+            return reportJobError(e, configJson);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 5;
+        }
+        pbar.finish();
+        std::chrono::duration<double> renderDuration = std::chrono::steady_clock::now() - renderStart;
+        std::cout << "*** Framed " << stats.frameCount << " images" << std::endl;
+        reportRenderStats(stats, renderDuration.count(), printStats, tracePath);
+        return 0;
     }
-    double pH = std::get<0>(padding), pV = std::get<1>(padding);
-    DEBUG_PRINTLN("*** Parsed padding: pH " << pH << ", pV " << pV);
 
-    // only one of width,height nonzero values is used to retain proper aspect ratio
-    if (width > 0) {
-        double f = (double) width / (config.templateWidth + 2 * pH * config.templateWidth);
-        height = (int) round(f * (config.templateHeight + 2 * pV * config.templateHeight));
-    } else if (height > 0) {
-        double f = (double) height / (config.templateHeight + 2 * pV * config.templateHeight);
-        width = (int) round(f * (config.templateWidth + 2 * pH * config.templateWidth));
-    } else {
-        width = config.templateWidth + (int) (2 * pH * config.templateWidth);
-        height = config.templateHeight + (int) (2 * pV * config.templateHeight);
+    std::optional<ResolvedJob> job;
+    try {
+        job = resolveJob(request, configJson);
+    } catch (const JobError& e) {
+        return reportJobError(e, configJson);
+    }
+    if (job->templateDetected) {
+        // print detected template
+        auto pathNoExt = fs::path(job->overlayConfig.imagePath).replace_extension("");
+        std::cout << "*** Detected template: " << pathNoExt.filename() << std::endl;
+    }
+    avo::OutputConfig& output = job->outputConfig;
+    std::cout << "*** Output configuration: " << output.width << "x" << output.height << ", " << output.fps << "fps"
+              << ", " << output.backgroundColor.hexString() << (output.deepColor ? ", 10-bit" : "") << std::endl;
+    if (job->inputBitDepth > 8 && !output.deepColor && !request.isPreview()) {
+        std::cout << "*** Input has " << job->inputBitDepth << "-bit samples, which are reduced to 8 bits without --deep-color" << std::endl;
     }
-    DEBUG_PRINTLN("*** Output frame dimensions: [" << width << ", " << height << "]");
-
-    // start overlay task
-    avo::OutputConfig output(outputPath, fps, width, height, pH, pV, backgroundColor);
-    std::cout << "*** Output configuration: " << width << "x" << height << ", " << fps << "fps" << ", " << backgroundColor.hexString() << std::endl;
-    avo::Task<cv::Mat> task = ovl.overlayTask<cv::Mat>(output);
-
-    task.initialize();
 
-    cv::Mat frame;
-    tqdm pbar;
-    int index = 0;
-    while (cap.isOpened()) {
-        if (!cap.read(frame)) {
-            break;
+    // identical job rendered before (previews are not cached)
+    std::string cacheKey;
+    if (outputCache && !request.isPreview()) {
+        try {
+            cacheKey = OutputCache::key(*job);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 2;
         }
+        if (outputCache->restore(cacheKey, request.outputPath)) {
+            std::cout << "*** Restored from output cache" << std::endl;
+            return 0;
+        }
+    }
 
-        task.feedFrame(frame);
-        pbar.progress(index, totalFrames);
-        index += 1;
+    avo::Profiler::setEnabled(printStats || !tracePath.empty());
+    auto renderStart = std::chrono::steady_clock::now();
+    tqdm pbar;
+    auto progress = [&pbar](int index, int total) { pbar.progress(index, total); };
+    avo::RenderStats stats;
+    try {
+        avo::Overlayer ovl(job->overlayConfig);
+        stats = request.isPreview() ? renderPreviewJob(*job, ovl, progress) : renderJob(*job, ovl, progress);
+    } catch (const JobError& e) {
+        return reportJobError(e, configJson);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 5;
     }
     pbar.finish();
-    cap.release();
-    task.finalize();
+    std::chrono::duration<double> renderDuration = std::chrono::steady_clock::now() - renderStart;
+    if (request.isPreview()) {
+        std::cout << "*** Preview rendered in " << (int) (renderDuration.count() * 1000.0) << " ms" << std::endl;
+    }
+    reportRenderStats(stats, renderDuration.count(), printStats, tracePath);
+    if (outputCache && !request.isPreview()) {
+        outputCache->store(cacheKey, request.outputPath);
+    }
 
     return 0;
 }
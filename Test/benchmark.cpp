@@ -3,37 +3,244 @@
 //
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <vector>
+#include <string>
 #include <filesystem>
 #include <chrono>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <cmath>
+#include <memory>
 #include <opencv2/core.hpp>
 #include <opencv2/core/ocl.hpp>
+#include <opencv2/imgproc.hpp>
+#include <nlohmann/json.hpp>
 #include "Overlayer.hpp"
 #include "OutputConfig.hpp"
 
 namespace fs = std::filesystem;
 namespace chrono = std::chrono;
+using nlohmann::json;
 
 #ifndef RESOURCES_PATH
 #error "RESOURCES_PATH must be defined before compilation"
 #endif
 
-template<typename Image>
-Image genSampleMat(int width, int height) {
-    Image img(width, height, CV_8UC3);
-    img.setTo(cv::Scalar(0xff, 0xff, 0xff));
+/**
+ * Usage: SFBenchmark [OPTIONS]
+ *
+ * Options (lists are comma separated):
+ * --templates - template keys from contents.json (default - all)
+ * --scales - output scales relative to template size (default - 0.5,1.0)
+ * --paddings - uniform paddings (default - 0.16)
+ * --threads - OpenCV thread counts (default - number of cores)
+ * --backends - cpu, compact, opencl (default - cpu,compact and opencl if available)
+ * --iters - measured frames per configuration (default - 60)
+ * --json - path of JSON results
+ * --csv - path of CSV results
+ */
 
-    return img;
+struct BenchmarkOptions {
+    std::vector<std::string> templates;
+    std::vector<double> scales = {0.5, 1.0};
+    std::vector<double> paddings = {0.16};
+    std::vector<int> threads = {(int) std::max(1u, std::thread::hardware_concurrency())};
+    std::vector<std::string> backends = {"cpu", "compact", "opencl"};
+    int iterations = 60;
+    std::string jsonPath;
+    std::string csvPath;
+};
+
+// Summary of durations of single stage, in microseconds
+struct StageStats {
+    double min = 0.0;
+    double median = 0.0;
+    double p99 = 0.0;
+    double mean = 0.0;
+};
+
+struct BenchmarkResult {
+    std::string templateKey;
+    std::string backend;
+    double scale;
+    double padding;
+    int threads;
+    int outputWidth;
+    int outputHeight;
+    double taskInit;
+    std::vector<std::pair<std::string, StageStats>> stages;
+};
+
+static const std::vector<std::string> STAGE_NAMES = {"resize", "blend", "pack", "encode", "frame"};
+
+template<typename T>
+std::vector<T> parseList(const std::string& str, std::function<T(const std::string&)> convert) {
+    std::vector<T> values;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(convert(item));
+        }
+    }
+
+    return values;
 }
 
-template<typename Numeric>
-Numeric average(std::vector<Numeric>& values) {
-    Numeric acc = 0;
-    for (Numeric& n : values) {
-        acc += n;
+BenchmarkOptions parseOptions(int argc, char** argv) {
+    BenchmarkOptions options;
+    auto identity = [](const std::string& s) { return s; };
+    auto toDouble = [](const std::string& s) { return std::stod(s); };
+    auto toInt = [](const std::string& s) { return std::stoi(s); };
+    for (int i = 1; i < argc; i += 2) {
+        std::string key = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value of option: " + key);
+        }
+        std::string value = argv[i + 1];
+        if (key == "--templates") {
+            options.templates = parseList<std::string>(value, identity);
+        } else if (key == "--scales") {
+            options.scales = parseList<double>(value, toDouble);
+        } else if (key == "--paddings") {
+            options.paddings = parseList<double>(value, toDouble);
+        } else if (key == "--threads") {
+            options.threads = parseList<int>(value, toInt);
+        } else if (key == "--backends") {
+            options.backends = parseList<std::string>(value, identity);
+        } else if (key == "--iters") {
+            options.iterations = std::stoi(value);
+        } else if (key == "--json") {
+            options.jsonPath = value;
+        } else if (key == "--csv") {
+            options.csvPath = value;
+        } else {
+            throw std::invalid_argument("Unknown option: " + key);
+        }
+    }
+
+    return options;
+}
+
+/**
+ * Generates frames resembling screen recordings: gradient background,
+ * ui-like blocks and text, with sensor-like noise, so that neither
+ * resize nor encoder work on trivially uniform input
+ */
+std::vector<cv::Mat> genSampleFrames(int width, int height, int count) {
+    cv::RNG rng(0x5f);
+    std::vector<cv::Mat> frames;
+    for (int i = 0; i < count; i++) {
+        cv::Mat frame(height, width, CV_8UC3);
+        for (int y = 0; y < height; y++) {
+            auto* row = frame.ptr<cv::Vec3b>(y);
+            for (int x = 0; x < width; x++) {
+                row[x] = cv::Vec3b(
+                    (uint8_t) (255 * x / width),
+                    (uint8_t) (255 * y / height),
+                    (uint8_t) ((i * 16 + x + y) & 0xff)
+                );
+            }
+        }
+        for (int j = 0; j < 12; j++) {
+            cv::Point origin(rng.uniform(0, width), rng.uniform(0, height));
+            cv::Size size(rng.uniform(width / 10, width / 2), rng.uniform(height / 40, height / 8));
+            cv::Scalar color(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255));
+            cv::rectangle(frame, cv::Rect(origin, size), color, cv::FILLED);
+            cv::putText(frame, "ScreenFramer " + std::to_string(i * 12 + j), origin,
+                        cv::FONT_HERSHEY_SIMPLEX, std::max(0.5, width / 600.0), cv::Scalar::all(255 - color[0]), 2);
+        }
+        cv::Mat noise(height, width, CV_16SC3);
+        rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(8));
+        cv::add(frame, noise, frame, cv::noArray(), CV_8U);
+        frames.push_back(frame);
+    }
+
+    return frames;
+}
+
+StageStats summarize(std::vector<double> values) {
+    StageStats stats;
+    if (values.empty()) {
+        return stats;
+    }
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (double v : values) {
+        sum += v;
     }
+    stats.min = values.front();
+    stats.median = values[values.size() / 2];
+    stats.p99 = values[std::min(values.size() - 1, (size_t) std::ceil(values.size() * 0.99) - 1)];
+    stats.mean = sum / values.size();
 
-    return acc / values.size();
+    return stats;
+}
+
+template<typename Fn>
+double measure(Fn&& fn) {
+    auto start = chrono::steady_clock::now();
+    fn();
+    // wait for asynchronous OpenCL work, so that it's attributed to stage which queued it
+    if (cv::ocl::useOpenCL()) {
+        cv::ocl::finish();
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, std::micro>(end - start).count();
+}
+
+template<class MatType>
+MatType toTaskFrame(const cv::Mat& frame) {
+    MatType result;
+    frame.copyTo(result);
+    return result;
+}
+
+template<class MatType>
+BenchmarkResult benchmark(
+    avo::Overlayer& overlayer,
+    avo::OutputConfig& output,
+    const std::vector<cv::Mat>& frames,
+    const int iters
+) {
+    BenchmarkResult result;
+    std::vector<MatType> taskFrames;
+    for (const auto& frame : frames) {
+        taskFrames.push_back(toTaskFrame<MatType>(frame));
+    }
+
+    // START task init
+    std::unique_ptr<avo::Task<MatType>> task;
+    result.taskInit = measure([&]() {
+        task = std::make_unique<avo::Task<MatType>>(overlayer.overlayTask<MatType>(output));
+        task->initialize();
+    });
+    // END task init
+
+    // START frame processing, per stage
+    std::vector<std::vector<double>> durations(STAGE_NAMES.size());
+    for (int i = 0; i < iters; i++) {
+        MatType& frame = taskFrames[i % taskFrames.size()];
+        double resize = measure([&]() { task->resizeFrame(frame); });
+        double blend = measure([&]() { task->blendFrame(); });
+        double pack = measure([&]() { task->packFrame(); });
+        double encode = measure([&]() { task->writeFrame(); });
+        std::vector<double> values = {resize, blend, pack, encode, resize + blend + pack + encode};
+        for (size_t s = 0; s < values.size(); s++) {
+            durations[s].push_back(values[s]);
+        }
+    }
+    task->finalize();
+    // END frame processing
+
+    for (size_t s = 0; s < STAGE_NAMES.size(); s++) {
+        result.stages.emplace_back(STAGE_NAMES[s], summarize(durations[s]));
+    }
+
+    return result;
 }
 
 void checkOpenCL() {
@@ -48,7 +255,7 @@ void checkOpenCL() {
         return;
     }
 
-    std::cout << context.ndevices() << " OpenCL devices are detected." << std::endl; //This bit provides an overview of the OpenCL devices you have in your computer
+    std::cout << context.ndevices() << " OpenCL devices are detected." << std::endl;
     for (unsigned long i = 0; i < context.ndevices(); i++) {
         cv::ocl::Device device = context.device(i);
         std::cout << "name:              " << device.name() << std::endl;
@@ -57,61 +264,136 @@ void checkOpenCL() {
         std::cout << "OpenCL_C_Version:  " << device.OpenCL_C_Version() << std::endl;
         std::cout << std::endl;
     }
-    cv::ocl::Device(context.device(0)); //Here is where you change which GPU to use (e.g. 0 or 1)
 }
 
-template<class MatType>
-void benchmark(avo::Overlayer& overlayer, avo::OutputConfig& output, const int iters = 300) {
-    auto frame = genSampleMat<MatType>(886, 1920);
-    // START task init
-    auto taskStart = chrono::high_resolution_clock::now();
-    auto task = overlayer.overlayTask<MatType>(output);
-    task.initialize();
-    auto taskEnd = chrono::high_resolution_clock::now();
-    auto taskDuration = chrono::duration_cast<chrono::microseconds>(taskEnd - taskStart).count();
-    std::cout << "   ==> Task creation: " << taskDuration << " us" << std::endl;
-    // END task init
+void printResult(const BenchmarkResult& r) {
+    std::cout << r.templateKey << " [" << r.backend << ", " << r.outputWidth << "x" << r.outputHeight
+              << ", padding " << r.padding << ", " << r.threads << " threads]" << std::endl;
+    std::cout << "   ==> Task creation: " << (long long) r.taskInit << " us" << std::endl;
+    for (const auto& [name, stats] : r.stages) {
+        std::cout << "   ==> " << name << ": min " << (long long) stats.min << " us, median "
+                  << (long long) stats.median << " us, p99 " << (long long) stats.p99 << " us" << std::endl;
+    }
+}
 
-    // START average frame processing
-    std::vector<long long> results;
-    for (int i = 0; i < iters; i++) {
-        auto start = chrono::high_resolution_clock::now();
-        task.feedFrame(frame);
-        auto end = chrono::high_resolution_clock::now();
-        auto duration = chrono::duration_cast<chrono::microseconds>(end - start).count();
-        results.push_back(duration);
-    }
-    task.finalize();
-    auto avgResult = average(results);
-    std::cout << "   ==> Avg frame proc.: " << avgResult << std::endl;
-    // END average frame processing
+void writeJson(const std::vector<BenchmarkResult>& results, const std::string& path) {
+    json array = json::array();
+    for (const auto& r : results) {
+        json entry = {
+            {"template", r.templateKey}, {"backend", r.backend}, {"scale", r.scale},
+            {"padding", r.padding}, {"threads", r.threads},
+            {"width", r.outputWidth}, {"height", r.outputHeight},
+            {"task_init_us", r.taskInit}
+        };
+        for (const auto& [name, stats] : r.stages) {
+            entry["stages"][name] = {
+                {"min_us", stats.min}, {"median_us", stats.median},
+                {"p99_us", stats.p99}, {"mean_us", stats.mean}
+            };
+        }
+        array.push_back(entry);
+    }
+    std::ofstream file(path);
+    file << array.dump(2) << std::endl;
+}
+
+void writeCsv(const std::vector<BenchmarkResult>& results, const std::string& path) {
+    std::ofstream file(path);
+    file << "template,backend,scale,padding,threads,width,height,task_init_us";
+    for (const auto& name : STAGE_NAMES) {
+        file << "," << name << "_min_us," << name << "_median_us," << name << "_p99_us," << name << "_mean_us";
+    }
+    file << std::endl;
+    for (const auto& r : results) {
+        file << r.templateKey << "," << r.backend << "," << r.scale << "," << r.padding << ","
+             << r.threads << "," << r.outputWidth << "," << r.outputHeight << "," << r.taskInit;
+        for (const auto& stage : r.stages) {
+            const StageStats& s = stage.second;
+            file << "," << s.min << "," << s.median << "," << s.p99 << "," << s.mean;
+        }
+        file << std::endl;
+    }
 }
 
 int main(int argc, char** argv) {
     fs::path dir(RESOURCES_PATH);
-    fs::path tempDir = fs::temp_directory_path();
-
-    auto config = avo::OverlayConfig(
-        (dir / "Apple iPhone 11 White.png").string(),
-        75, 71,
-        903, 1863,
-        979, 1934);
-    // Original tests were made on apples iPhone 11 template
-    // with resolution 2286 x 4000, and was padded with 0.16x0.08
-    auto output = avo::OutputConfig(
-        tempDir / "sfbenchoutputS0SK28SHF73OZP74.mp4",
-        60.0, 2286, 4000,
-        0.16, 0.08);
-    avo::Overlayer overlayer(config);
-
-    cv::ocl::setUseOpenCL(true);
+    fs::path outputPath = fs::temp_directory_path() / "sfbenchoutputS0SK28SHF73OZP74.mp4";
+
+    BenchmarkOptions options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error parsing options: " << e.what() << std::endl;
+        return 1;
+    }
+
+    json contents;
+    std::ifstream contentsFile(dir / "contents.json");
+    contentsFile >> contents;
+    if (options.templates.empty()) {
+        for (auto it = contents.begin(); it != contents.end(); ++it) {
+            options.templates.push_back(it.key());
+        }
+    }
+
+    bool haveOpenCL = cv::ocl::haveOpenCL();
     checkOpenCL();
-    std::cout<< "GPU" << std::endl;
-    benchmark<cv::UMat>(overlayer, output, 1000);
 
-    cv::ocl::setUseOpenCL(false);
-    std::cout<< "CPU" << std::endl;
-    benchmark<cv::Mat>(overlayer, output, 1000);
+    std::vector<BenchmarkResult> results;
+    for (const auto& key : options.templates) {
+        if (!contents.contains(key)) {
+            std::cerr << "Unknown template: " << key << std::endl;
+            return 2;
+        }
+        const json& entry = contents[key];
+        std::string imagePath = (dir / entry["images"][entry["default_image"].get<std::string>()].get<std::string>()).string();
+        int left = entry["left"], top = entry["top"], right = entry["right"], bottom = entry["bottom"];
+        int templateWidth = entry["res_width"], templateHeight = entry["res_height"];
+        auto config = avo::OverlayConfig(imagePath, left, top, right, bottom, templateWidth, templateHeight);
+        avo::Overlayer overlayer(config);
+
+        // input at native resolution of template screen
+        auto frames = genSampleFrames(right - left, bottom - top, 8);
+        for (double scale : options.scales) {
+            for (double padding : options.paddings) {
+                int width = (int) std::round(scale * templateWidth * (1.0 + 2 * padding));
+                int height = (int) std::round(scale * templateHeight * (1.0 + 2 * padding));
+                for (int threads : options.threads) {
+                    cv::setNumThreads(threads);
+                    for (const auto& backend : options.backends) {
+                        bool useOpenCL = backend == "opencl";
+                        if (useOpenCL && !haveOpenCL) {
+                            continue;
+                        }
+                        cv::ocl::setUseOpenCL(useOpenCL);
+
+                        auto output = avo::OutputConfig(outputPath.string(), 60.0, width, height, padding, padding);
+                        output.compactMemory = backend == "compact";
+                        BenchmarkResult result = useOpenCL
+                            ? benchmark<cv::UMat>(overlayer, output, frames, options.iterations)
+                            : benchmark<cv::Mat>(overlayer, output, frames, options.iterations);
+                        result.templateKey = key;
+                        result.backend = backend;
+                        result.scale = scale;
+                        result.padding = padding;
+                        result.threads = threads;
+                        result.outputWidth = width;
+                        result.outputHeight = height;
+                        printResult(result);
+                        results.push_back(result);
+                    }
+                }
+            }
+        }
+    }
+    fs::remove(outputPath);
+
+    if (!options.jsonPath.empty()) {
+        writeJson(results, options.jsonPath);
+    }
+    if (!options.csvPath.empty()) {
+        writeCsv(results, options.csvPath);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
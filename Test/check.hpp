@@ -0,0 +1,49 @@
+#ifndef SCREENFRAMER_TEST_CHECK_HPP
+#define SCREENFRAMER_TEST_CHECK_HPP
+
+#include <iostream>
+
+// Minimal checks of unit tests: failures are reported and counted, test continues
+namespace check {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+// exit code of test executable
+inline int result(const char* testName) {
+    if (failures() > 0) {
+        std::cerr << "*** " << testName << ": " << failures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "*** " << testName << ": passed" << std::endl;
+    return 0;
+}
+
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #condition << std::endl; \
+            check::failures() += 1; \
+        } \
+    } while (0)
+
+#define CHECK_THROWS(expression, exceptionType) \
+    do { \
+        bool thrown = false; \
+        try { \
+            (void) (expression); \
+        } catch (const exceptionType&) { \
+            thrown = true; \
+        } \
+        if (!thrown) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": expected " << #exceptionType << " from: " \
+                      << #expression << std::endl; \
+            check::failures() += 1; \
+        } \
+    } while (0)
+
+#endif //SCREENFRAMER_TEST_CHECK_HPP
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include "Compositor.hpp"
+#include "check.hpp"
+
+using namespace avo;
+
+/**
+ * Usage: SFCompositorTest
+ *
+ * Compares compositor with reference blends: exact integer formula for 8-bit formats,
+ * and cv::multiply / cv::add (blending of default task path before compositor) for float formats.
+ */
+
+// template-like inverse alpha: opaque border, transparent interior, antialiased edges in between
+static cv::Mat testInverseAlpha(cv::Size size) {
+    cv::Mat alpha(size, CV_8UC1, cv::Scalar(255));
+    cv::rectangle(alpha, cv::Rect(size.width / 8, size.height / 8, size.width * 3 / 4, size.height * 3 / 4), 0, cv::FILLED);
+    cv::GaussianBlur(alpha, alpha, cv::Size(9, 9), 0);
+    return 255 - alpha;
+}
+
+static cv::Mat randomImage(cv::Size size, int type) {
+    cv::Mat image(size, type);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(256));
+    return image;
+}
+
+static void testInteger() {
+    cv::Size size(97, 61);
+    cv::Mat inverseAlpha = testInverseAlpha(size);
+    cv::Mat alpha3;
+    cv::cvtColor(255 - inverseAlpha, alpha3, cv::COLOR_GRAY2BGR);
+    cv::Mat source;
+    cv::multiply(randomImage(size, CV_8UC3), alpha3, source, 1.0 / 255.0);
+    cv::Mat destination = randomImage(size, CV_8UC3);
+
+    // dst = src + round(inverseAlpha * dst / 255), saturated
+    cv::Mat expected = destination.clone();
+    for (int y = 0; y < size.height; y++) {
+        for (int x = 0; x < size.width; x++) {
+            int a = inverseAlpha.at<uint8_t>(y, x);
+            for (int c = 0; c < 3; c++) {
+                int dst = destination.at<cv::Vec3b>(y, x)[c];
+                int blended = source.at<cv::Vec3b>(y, x)[c] + (a * dst + 127) / 255;
+                expected.at<cv::Vec3b>(y, x)[c] = (uint8_t) std::min(blended, 255);
+            }
+        }
+    }
+
+    cv::Mat over = destination.clone();
+    Compositor<PixelFormat::BGR24, BlendPolicy::PremultipliedOver>(inverseAlpha).apply(over, source);
+    CHECK(cv::norm(over, expected, cv::NORM_INF) == 0.0);
+
+    // edge only skips transparent pixels, whose result equals destination
+    cv::Mat edges = destination.clone();
+    Compositor<PixelFormat::BGR24, BlendPolicy::EdgeOnly> edgeCompositor(inverseAlpha);
+    edgeCompositor.apply(edges, source);
+    CHECK(cv::norm(edges, expected, cv::NORM_INF) == 0.0);
+    CHECK(edgeCompositor.visitedPixels() == (size_t) cv::countNonZero(inverseAlpha != 255));
+
+    // opaque copy replaces covered pixels only
+    cv::Mat coverage = inverseAlpha < 128;
+    cv::Mat copied = destination.clone();
+    Compositor<PixelFormat::BGR24, BlendPolicy::OpaqueCopy>(coverage).apply(copied, source);
+    cv::Mat expectedCopy = destination.clone();
+    source.copyTo(expectedCopy, coverage);
+    CHECK(cv::norm(copied, expectedCopy, cv::NORM_INF) == 0.0);
+}
+
+static void testFloat() {
+    // assets of default task path: float device * alpha, 3-channel float inverse alpha in [0, 1]
+    cv::Size size(101, 67);
+    cv::Mat mask;
+    testInverseAlpha(size).convertTo(mask, CV_32F, 1.0 / 255.0);
+    cv::Mat mask3;
+    cv::cvtColor(mask, mask3, cv::COLOR_GRAY2BGR);
+    cv::Mat device;
+    randomImage(size, CV_8UC3).convertTo(device, CV_32F);
+    cv::Mat alpha3;
+    cv::subtract(1.0, mask3, alpha3);
+    cv::multiply(device, alpha3, device);
+    cv::Mat screen;
+    randomImage(size, CV_8UC3).convertTo(screen, CV_32F);
+
+    cv::Mat expected;
+    cv::multiply(screen, mask3, expected);
+    cv::add(expected, device, expected);
+
+    cv::Mat inverseAlpha;
+    cv::extractChannel(mask3, inverseAlpha, 0);
+    cv::Mat over = screen.clone();
+    Compositor<PixelFormat::BGR96F, BlendPolicy::PremultipliedOver>(inverseAlpha).apply(over, device);
+    CHECK(cv::norm(over, expected, cv::NORM_INF) == 0.0);
+    cv::Mat edges = screen.clone();
+    Compositor<PixelFormat::BGR96F, BlendPolicy::EdgeOnly>(inverseAlpha).apply(edges, device);
+    CHECK(cv::norm(edges, expected, cv::NORM_INF) == 0.0);
+
+    // packed 8-bit output is identical too
+    cv::Mat expected8, edges8;
+    expected.convertTo(expected8, CV_8U);
+    edges.convertTo(edges8, CV_8U);
+    CHECK(cv::norm(edges8, expected8, cv::NORM_INF) == 0.0);
+}
+
+int main() {
+    cv::setRNGSeed(7);
+    testInteger();
+    testFloat();
+    return check::result("SFCompositorTest");
+}
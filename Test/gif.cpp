@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "FrameWriter.hpp"
+#include "check.hpp"
+
+namespace fs = std::filesystem;
+
+/**
+ * Usage: SFGifTest
+ *
+ * Encodes frames with GifWriter and decodes them back with minimal GIF decoder below,
+ * colors of test frames are centers of histogram bins, so that they are kept by palettes.
+ */
+
+// Decoder of GIF files written by GifWriter (local color tables, no interlacing)
+class GifReader {
+private:
+    std::vector<uint8_t> _data;
+    size_t _pos = 0;
+public:
+    explicit GifReader(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        _data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    std::vector<cv::Mat> readFrames() {
+        if (_data.size() < 13 || std::string(_data.begin(), _data.begin() + 6) != "GIF89a") {
+            throw std::runtime_error("Not a GIF89a file");
+        }
+        cv::Mat canvas(readShort(6 + 2), readShort(6), CV_8UC3, cv::Scalar(0, 0, 0));
+        _pos = 13 + ((_data[10] & 0x80) ? 3 * (2 << (_data[10] & 7)) : 0);
+
+        std::vector<cv::Mat> frames;
+        while (_pos < _data.size()) {
+            uint8_t introducer = _data[_pos++];
+            if (introducer == 0x3b) {
+                return frames;
+            } else if (introducer == 0x21) {
+                _pos += 1;
+                readSubBlocks();
+            } else if (introducer == 0x2c) {
+                readImage(canvas);
+                frames.push_back(canvas.clone());
+            } else {
+                throw std::runtime_error("Unknown GIF block");
+            }
+        }
+        throw std::runtime_error("GIF trailer is missing");
+    }
+private:
+    int readShort(size_t offset) const {
+        return _data.at(offset) | (_data.at(offset + 1) << 8);
+    }
+
+    std::vector<uint8_t> readSubBlocks() {
+        std::vector<uint8_t> bytes;
+        while (true) {
+            size_t size = _data.at(_pos++);
+            if (size == 0) {
+                return bytes;
+            }
+            bytes.insert(bytes.end(), _data.begin() + _pos, _data.begin() + _pos + size);
+            _pos += size;
+        }
+    }
+
+    void readImage(cv::Mat& canvas) {
+        cv::Rect rect(readShort(_pos), readShort(_pos + 2), readShort(_pos + 4), readShort(_pos + 6));
+        uint8_t flags = _data.at(_pos + 8);
+        _pos += 9;
+        std::vector<cv::Vec3b> colors;
+        if (flags & 0x80) {
+            int count = 2 << (flags & 7);
+            for (int i = 0; i < count; i++) {
+                colors.emplace_back(_data.at(_pos + 3 * i + 2), _data.at(_pos + 3 * i + 1), _data.at(_pos + 3 * i));
+            }
+            _pos += 3 * count;
+        }
+        int minCodeSize = _data.at(_pos++);
+        std::vector<uint8_t> indices = lzwDecode(readSubBlocks(), minCodeSize);
+        if (indices.size() != (size_t) rect.area() || colors.empty()) {
+            throw std::runtime_error("Invalid GIF image data");
+        }
+        for (int y = 0; y < rect.height; y++) {
+            for (int x = 0; x < rect.width; x++) {
+                canvas.at<cv::Vec3b>(rect.y + y, rect.x + x) = colors.at(indices[y * rect.width + x]);
+            }
+        }
+    }
+
+    static std::vector<uint8_t> lzwDecode(const std::vector<uint8_t>& bytes, int minCodeSize) {
+        const int clearCode = 1 << minCodeSize, endCode = clearCode + 1;
+        std::vector<std::vector<uint8_t>> table;
+        auto reset = [&]() {
+            table.clear();
+            for (int i = 0; i < clearCode + 2; i++) {
+                table.push_back({(uint8_t) i});
+            }
+        };
+        reset();
+        int codeSize = minCodeSize + 1;
+        int previous = -1;
+        std::vector<uint8_t> output;
+        size_t bit = 0;
+        while (bit + codeSize <= bytes.size() * 8) {
+            int code = 0;
+            for (int i = 0; i < codeSize; i++, bit++) {
+                code |= ((bytes[bit / 8] >> (bit % 8)) & 1) << i;
+            }
+            if (code == clearCode) {
+                reset();
+                codeSize = minCodeSize + 1;
+                previous = -1;
+                continue;
+            }
+            if (code == endCode) {
+                return output;
+            }
+            std::vector<uint8_t> entry;
+            if (code < (int) table.size()) {
+                entry = table[code];
+            } else if (code == (int) table.size() && previous >= 0) {
+                entry = table[previous];
+                entry.push_back(table[previous][0]);
+            } else {
+                throw std::runtime_error("Invalid LZW code");
+            }
+            output.insert(output.end(), entry.begin(), entry.end());
+            if (previous >= 0 && table.size() < 4096) {
+                std::vector<uint8_t> added = table[previous];
+                added.push_back(entry[0]);
+                table.push_back(added);
+            }
+            if ((int) table.size() == (1 << codeSize) && codeSize < 12) {
+                codeSize += 1;
+            }
+            previous = code;
+        }
+        throw std::runtime_error("LZW end code is missing");
+    }
+};
+
+// one of 32 colors at centers of distinct histogram bins
+static cv::Vec3b testColor(int i) {
+    return {(uint8_t) ((i * 7 % 32) * 8 + 4), (uint8_t) ((i * 13 % 32) * 8 + 4), (uint8_t) (i * 8 + 4)};
+}
+
+// pseudo-random colors in 2x2 blocks (histograms are subsampled by 2), long enough to fill LZW dictionary
+static cv::Mat testFrame(cv::Size size, uint32_t seed) {
+    cv::Mat frame(size, CV_8UC3);
+    for (int y = 0; y < size.height; y++) {
+        for (int x = 0; x < size.width; x++) {
+            uint32_t h = ((uint32_t) (y / 2) * 73856093u) ^ ((uint32_t) (x / 2) * 19349663u) ^ (seed * 83492791u);
+            frame.at<cv::Vec3b>(y, x) = testColor((int) ((h ^ (h >> 13)) % 32));
+        }
+    }
+    return frame;
+}
+
+static double maxDifference(const cv::Mat& a, const cv::Mat& b) {
+    return a.size() == b.size() ? cv::norm(a, b, cv::NORM_INF) : 1e9;
+}
+
+static void testFullFrames(const fs::path& path) {
+    cv::Size size(256, 192);
+    std::vector<cv::Mat> frames = {testFrame(size, 1), testFrame(size, 2)};
+    avo::GifWriter writer;
+    CHECK(writer.open(path.string(), 25.0, size));
+    for (const cv::Mat& frame : frames) {
+        writer.write(frame);
+    }
+    writer.release();
+
+    std::vector<cv::Mat> decoded = GifReader(path.string()).readFrames();
+    CHECK(decoded.size() == frames.size());
+    for (size_t i = 0; i < std::min(decoded.size(), frames.size()); i++) {
+        CHECK(maxDifference(decoded[i], frames[i]) == 0.0);
+    }
+}
+
+static void testStaticFrame(const fs::path& path) {
+    // left half is static, only right half is written after first frame
+    cv::Size size(128, 96);
+    cv::Mat staticFrame = testFrame(size, 3);
+    cv::Mat staticMask(size, CV_8UC1, cv::Scalar(0));
+    staticMask(cv::Rect(0, 0, size.width / 2, size.height)).setTo(255);
+    avo::GifWriter writer;
+    CHECK(writer.open(path.string(), 25.0, size));
+    writer.setStaticFrame(staticFrame, staticMask);
+    std::vector<cv::Mat> frames;
+    for (uint32_t i = 0; i < 3; i++) {
+        cv::Mat frame = testFrame(size, 10 + i);
+        staticFrame.copyTo(frame, staticMask);
+        writer.write(frame);
+        frames.push_back(frame);
+    }
+    writer.release();
+
+    std::vector<cv::Mat> decoded = GifReader(path.string()).readFrames();
+    CHECK(decoded.size() == frames.size());
+    for (size_t i = 0; i < std::min(decoded.size(), frames.size()); i++) {
+        // static and dynamic colors share color table, so few colors may be merged
+        CHECK(maxDifference(decoded[i], frames[i]) <= 8.0);
+    }
+}
+
+int main() {
+    fs::path directory = fs::temp_directory_path();
+    fs::path path = directory / "sf-gif-test.gif";
+    try {
+        testFullFrames(path);
+        testStaticFrame(path);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        check::failures() += 1;
+    }
+    fs::remove(path);
+    return check::result("SFGifTest");
+}
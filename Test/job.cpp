@@ -0,0 +1,57 @@
+#include <string>
+#include <nlohmann/json.hpp>
+#include "Job.hpp"
+#include "check.hpp"
+
+/**
+ * Usage: SFJobTest
+ *
+ * Serializes job requests (as sent to daemon) to JSON and back.
+ */
+
+static void testRoundTrip() {
+    JobRequest request;
+    request.inputPath = "in/recording.mov";
+    request.outputPath = "out/framed.mp4";
+    request.templateKey = "iphone-15-pro:black-titanium";
+    request.width = 1920;
+    request.height = 1080;
+    request.padding = "0.1:0.2";
+    request.color = "#FFFFFF";
+    request.segments = 4;
+    request.backend = "opencl";
+    request.compactMemory = true;
+
+    json j = request;
+    JobRequest parsed = j.get<JobRequest>();
+    CHECK(parsed.inputPath == request.inputPath);
+    CHECK(parsed.outputPath == request.outputPath);
+    CHECK(parsed.templateKey == request.templateKey);
+    CHECK(parsed.width == 1920 && parsed.height == 1080);
+    CHECK(parsed.padding == request.padding);
+    CHECK(parsed.color == request.color);
+    CHECK(parsed.segments == 4);
+    CHECK(parsed.backend == "opencl");
+    CHECK(parsed.compactMemory);
+    // every serialized field is read back
+    CHECK(json(parsed) == j);
+}
+
+static void testDefaults() {
+    // missing fields keep defaults of JobRequest
+    JobRequest parsed = json::parse(R"({"input": "a.mov", "output": "b.mp4"})").get<JobRequest>();
+    JobRequest defaults;
+    defaults.inputPath = "a.mov";
+    defaults.outputPath = "b.mp4";
+    CHECK(json(parsed) == json(defaults));
+
+    // input and output are required
+    CHECK_THROWS(json::parse(R"({"input": "a.mov"})").get<JobRequest>(), json::exception);
+    CHECK_THROWS(json::parse(R"({"input": "a.mov", "output": 7})").get<JobRequest>(), json::exception);
+}
+
+int main() {
+    testRoundTrip();
+    testDefaults();
+    return check::result("SFJobTest");
+}
@@ -0,0 +1,43 @@
+#include <stdexcept>
+#include "Placement.hpp"
+#include "check.hpp"
+
+using namespace avo;
+
+/**
+ * Usage: SFPlacementTest
+ *
+ * Parses and formats CPU lists in kernel format (as in sysfs cpulist files and --cpus options).
+ */
+
+static void testParse() {
+    CHECK(parseCpuList("0-3,8,10-11\n") == CpuSet({0, 1, 2, 3, 8, 10, 11}));
+    // ranges are merged, sorted and deduplicated
+    CHECK(parseCpuList("5,1-2,2") == CpuSet({1, 2, 5}));
+    CHECK(parseCpuList("7") == CpuSet({7}));
+    CHECK(parseCpuList("").empty());
+    CHECK(parseCpuList("\n").empty());
+}
+
+static void testFormat() {
+    CHECK(formatCpuList({0, 1, 2, 3, 8, 10, 11}) == "0-3,8,10-11");
+    CHECK(formatCpuList({4}) == "4");
+    CHECK(formatCpuList({}).empty());
+    CHECK(formatCpuList(parseCpuList("16-23,0-7")) == "0-7,16-23");
+}
+
+static void testInvalid() {
+    CHECK_THROWS(parseCpuList("3-1"), std::invalid_argument);
+    CHECK_THROWS(parseCpuList("-1"), std::invalid_argument);
+    CHECK_THROWS(parseCpuList("1-"), std::invalid_argument);
+    CHECK_THROWS(parseCpuList("a"), std::invalid_argument);
+    CHECK_THROWS(parseCpuList("0-3,x"), std::invalid_argument);
+    CHECK_THROWS(parseCpuList("2 3"), std::invalid_argument);
+}
+
+int main() {
+    testParse();
+    testFormat();
+    testInvalid();
+    return check::result("SFPlacementTest");
+}
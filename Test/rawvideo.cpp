@@ -0,0 +1,94 @@
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <opencv2/core.hpp>
+#include "RawVideo.hpp"
+#include "check.hpp"
+
+namespace fs = std::filesystem;
+using namespace avo;
+
+/**
+ * Usage: SFRawVideoTest
+ *
+ * Maps Y4M and headerless raw files written by the test and checks parsed geometry,
+ * frame count and frame data.
+ */
+
+// 4x2 I420 frame (8 luma bytes, 2 + 2 chroma bytes) with bytes starting at given value
+static std::string i420Frame(uint8_t first) {
+    std::string frame;
+    for (int i = 0; i < 12; i++) {
+        frame += (char) (first + i);
+    }
+    return frame;
+}
+
+static void writeFile(const fs::path& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary);
+    file << contents;
+}
+
+static void testY4M(const fs::path& path) {
+    // truncated last frame is dropped
+    writeFile(path, "YUV4MPEG2 W4 H2 F30000:1001 Ip A1:1 C420jpeg XYSCSS=420JPEG\n"
+                    "FRAME\n" + i420Frame(0) + "FRAME Ixyz\n" + i420Frame(100) + "FRAME\n" + i420Frame(200).substr(0, 5));
+    MappedVideo video(path.string());
+    CHECK(video.format().width == 4);
+    CHECK(video.format().height == 2);
+    CHECK(std::abs(video.format().fps - 30000.0 / 1001.0) < 1e-9);
+    CHECK(video.format().pixelFormat == RawPixelFormat::I420);
+    CHECK(video.frameCount() == 2);
+    if (video.frameCount() == 2) {
+        cv::Mat view = video.frameView(1);
+        CHECK(view.rows == 3 && view.cols == 4 && view.type() == CV_8UC1);
+        CHECK(view.at<uint8_t>(0, 0) == 100 && view.at<uint8_t>(2, 3) == 111);
+    }
+}
+
+static void testUnsupportedY4M(const fs::path& path) {
+    writeFile(path, "YUV4MPEG2 W4 H2 F25:1 C420p10\nFRAME\n" + i420Frame(0) + i420Frame(0));
+    CHECK_THROWS(MappedVideo(path.string()), std::invalid_argument);
+    writeFile(path, "YUV4MPEG2 W4 H2 F25:1 C422\nFRAME\n" + i420Frame(0) + i420Frame(0));
+    CHECK_THROWS(MappedVideo(path.string()), std::invalid_argument);
+    writeFile(path, "YUV4MPEG2 W0 H2 F25:1\nFRAME\n" + i420Frame(0));
+    CHECK_THROWS(MappedVideo(path.string()), std::invalid_argument);
+    writeFile(path, "RIFF not a Y4M file\n");
+    CHECK_THROWS(MappedVideo(path.string()), std::invalid_argument);
+}
+
+static void testHeaderless(const fs::path& path) {
+    // two 2x2 BGR24 frames
+    writeFile(path, std::string(24, '\x10'));
+    RawVideoFormat format;
+    format.width = 2;
+    format.height = 2;
+    format.fps = 60.0;
+    format.pixelFormat = RawPixelFormat::BGR24;
+    MappedVideo video(path.string(), format);
+    CHECK(video.frameCount() == 2);
+    cv::Mat bgr;
+    cv::Mat& frame = video.readFrame(1, bgr);
+    CHECK(frame.type() == CV_8UC3 && frame.size() == cv::Size(2, 2));
+    CHECK(frame.at<cv::Vec3b>(1, 1) == cv::Vec3b(0x10, 0x10, 0x10));
+}
+
+int main() {
+    fs::path directory = fs::temp_directory_path();
+    fs::path y4mPath = directory / "sf-rawvideo-test.y4m";
+    fs::path rawPath = directory / "sf-rawvideo-test.bgr";
+    try {
+        testY4M(y4mPath);
+        testUnsupportedY4M(y4mPath);
+        testHeaderless(rawPath);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        check::failures() += 1;
+    }
+    fs::remove(y4mPath);
+    fs::remove(rawPath);
+    return check::result("SFRawVideoTest");
+}